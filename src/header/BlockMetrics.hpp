@@ -0,0 +1,313 @@
+#ifndef BLOCK_METRICS_H
+#define BLOCK_METRICS_H
+
+#include "ImagePixel.hpp"
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+// Block error metrics as compile-time policies. A metric provides
+//   State                                      sufficient statistics of a block, empty when constructed
+//   accumulate<C>(State&, const uint8_t*)      adds the samples of one pixel of a C-channel layout
+//   merge(State&, const State&)                combines the statistics of two disjoint blocks
+//   finalize(const S&, channels, double*)      error in [0, 1] and one representative value per channel
+// finalize is a template over the statistics type, so the same formula also runs on the pyramid's
+// BlockStatistics (see ErrorCalculator). MetricTreeBuilder inlines all four into its traversal.
+// A metric may also provide
+//   lowerBound(const State&, channels, total)  bound on the final error of a total-pixel block,
+//                                              from the statistics of the pixels seen so far
+// which lets a scan stop as soon as the block is known to split (see HasLowerBound).
+
+// The metrics below keep every step on the integer statistics exact and divide once at the end,
+// so an error depends only on the block's pixels, not on how the compiler orders or contracts
+// floating point steps. Like IntegerMoments, numerators that outgrow 64 bits on large blocks are
+// formed in 128 bits. The plane fit (ErrorCalculator::calculatePlaneResidual) is the exception: its
+// gradients are moment ratios, so the residual is a double and only the final scale is shared
+using ExactSum = unsigned __int128;
+
+// n times the sum of squared deviations of one channel from its mean: n * sumSquares - sum^2
+template <typename S>
+inline ExactSum scaledSquaredDeviation(const S& stats, int c) {
+    ExactSum sum = stats.sum[c];
+    return static_cast<ExactSum>(stats.count) * stats.sumSquares[c] - sum * sum;
+}
+
+// Sum of squared deviations of one channel from its own mean; no further pixel can lower it
+template <typename S>
+inline double squaredDeviation(const S& stats, int c) {
+    if (stats.count == 0) return 0.0;
+    return static_cast<double>(scaledSquaredDeviation(stats, c)) / stats.count;
+}
+
+// Sum of squared differences of one channel to a fixed value: sumSquares - 2 v sum + n v^2. The
+// result is non-negative and fits 64 bits, so the unsigned wrap-around of the middle term cancels
+template <typename S>
+inline uint64_t squaredErrorAround(const S& stats, int c, uint8_t value) {
+    return stats.sumSquares[c] - 2 * static_cast<uint64_t>(value) * stats.sum[c]
+         + stats.count * value * value;
+}
+
+// Count, sums and sums of squares per channel
+struct MomentState {
+    uint64_t count;
+    uint64_t sum[ChannelLayout::maxChannels];
+    uint64_t sumSquares[ChannelLayout::maxChannels];
+
+    MomentState() : count(0), sum(), sumSquares() {}
+
+    template <int C>
+    void add(const uint8_t* samples) {
+        count++;
+        for (int c = 0; c < C; c++) {
+            sum[c] += samples[c];
+            sumSquares[c] += static_cast<uint32_t>(samples[c]) * samples[c];
+        }
+    }
+    void merge(const MomentState& other) {
+        count += other.count;
+        for (int c = 0; c < ChannelLayout::maxChannels; c++) {
+            sum[c] += other.sum[c];
+            sumSquares[c] += other.sumSquares[c];
+        }
+    }
+};
+
+// Count and value range per channel
+struct RangeState {
+    uint64_t count;
+    uint8_t minValue[ChannelLayout::maxChannels];
+    uint8_t maxValue[ChannelLayout::maxChannels];
+
+    RangeState() : count(0) {
+        std::fill(minValue, minValue + ChannelLayout::maxChannels, 255);
+        std::fill(maxValue, maxValue + ChannelLayout::maxChannels, 0);
+    }
+};
+
+// Moments plus 256 bins per channel
+struct HistogramState : MomentState {
+    uint32_t histogram[ChannelLayout::maxChannels * 256];
+
+    HistogramState() : histogram() {}
+};
+
+struct VarianceMetric {
+    using State = MomentState;
+
+    template <int C>
+    static void accumulate(State& state, const uint8_t* samples) { state.template add<C>(samples); }
+    static void merge(State& state, const State& other) { state.merge(other); }
+
+    template <typename S>
+    static double finalize(const S& stats, int channels, double* means) {
+        meansOf(stats, channels, means);
+        if (stats.count == 0) return 0.0;
+
+        // Mean over channels of variance / (255^2 / 4)
+        ExactSum deviation = 0;
+        for (int c = 0; c < channels; c++) deviation += scaledSquaredDeviation(stats, c);
+        ExactSum scale = static_cast<ExactSum>(stats.count) * stats.count * (channels * 65025);
+        return 4.0 * static_cast<double>(deviation) / static_cast<double>(scale);
+    }
+
+    // The full block's squared deviation is at least the seen pixels' deviation from their own mean
+    static double lowerBound(const State& seen, int channels, uint64_t total) {
+        if (seen.count == 0) return 0.0;
+        ExactSum deviation = 0;
+        for (int c = 0; c < channels; c++) deviation += scaledSquaredDeviation(seen, c);
+        ExactSum scale = static_cast<ExactSum>(seen.count) * total * (channels * 65025);
+        return 4.0 * static_cast<double>(deviation) / static_cast<double>(scale);
+    }
+
+    template <typename S>
+    static void meansOf(const S& stats, int channels, double* means) {
+        for (int c = 0; c < channels; c++) {
+            means[c] = stats.count == 0 ? 0.0 : static_cast<double>(stats.sum[c]) / stats.count;
+        }
+    }
+};
+
+struct MeanAbsoluteDeviationMetric {
+    using State = HistogramState;
+
+    template <int C>
+    static void accumulate(State& state, const uint8_t* samples) {
+        state.template add<C>(samples);
+        for (int c = 0; c < C; c++) state.histogram[c * 256 + samples[c]]++;
+    }
+    static void merge(State& state, const State& other) {
+        state.merge(other);
+        for (int i = 0; i < ChannelLayout::maxChannels * 256; i++) state.histogram[i] += other.histogram[i];
+    }
+
+    template <typename S>
+    static double finalize(const S& stats, int channels, double* means) {
+        VarianceMetric::meansOf(stats, channels, means);
+        if (stats.count == 0) return 0.0;
+
+        // Mean over channels of MAD / (255 / 2), with n |v - mean| = |n v - sum| per sample
+        ExactSum deviation = 0;
+        for (int c = 0; c < channels; c++) {
+            const uint32_t* hist = &stats.histogram[c * 256];
+            const uint64_t sum = stats.sum[c];
+            for (int v = 0; v < 256; v++) {
+                if (!hist[v]) continue;
+                uint64_t scaled = stats.count * v;
+                deviation += static_cast<ExactSum>(hist[v]) * (scaled > sum ? scaled - sum : sum - scaled);
+            }
+        }
+        ExactSum scale = static_cast<ExactSum>(stats.count) * stats.count * (channels * 255);
+        return 2.0 * static_cast<double>(deviation) / static_cast<double>(scale);
+    }
+
+    // Deviations from any center, the final mean included, are smallest around the seen median
+    static double lowerBound(const State& seen, int channels, uint64_t total) {
+        uint64_t deviation = 0;
+        for (int c = 0; c < channels; c++) {
+            const uint32_t* hist = &seen.histogram[c * 256];
+            uint64_t below = 0;
+            int median = 0;
+            while (median < 255 && 2 * (below + hist[median]) < seen.count) below += hist[median++];
+            uint64_t sum = 0;
+            for (int v = 0; v < 256; v++) {
+                if (hist[v]) sum += static_cast<uint64_t>(hist[v]) * (v > median ? v - median : median - v);
+            }
+            deviation += sum;
+        }
+        ExactSum scale = static_cast<ExactSum>(total) * (channels * 255);
+        return 2.0 * static_cast<double>(deviation) / static_cast<double>(scale);
+    }
+};
+
+struct MaxDifferenceMetric {
+    using State = RangeState;
+
+    template <int C>
+    static void accumulate(State& state, const uint8_t* samples) {
+        state.count++;
+        for (int c = 0; c < C; c++) {
+            state.minValue[c] = std::min(state.minValue[c], samples[c]);
+            state.maxValue[c] = std::max(state.maxValue[c], samples[c]);
+        }
+    }
+    static void merge(State& state, const State& other) {
+        state.count += other.count;
+        for (int c = 0; c < ChannelLayout::maxChannels; c++) {
+            state.minValue[c] = std::min(state.minValue[c], other.minValue[c]);
+            state.maxValue[c] = std::max(state.maxValue[c], other.maxValue[c]);
+        }
+    }
+
+    // Represents the block by the midpoint of each channel's range
+    template <typename S>
+    static double finalize(const S& stats, int channels, double* midpoints) {
+        const double diffMax = 255.0;
+        double total = 0;
+        for (int c = 0; c < channels; c++) {
+            if (stats.count == 0) {
+                midpoints[c] = 0.0;
+                continue;
+            }
+            midpoints[c] = (stats.maxValue[c] + stats.minValue[c]) / 2.0;
+            total += stats.maxValue[c] - stats.minValue[c];
+        }
+        return total / (channels * diffMax);
+    }
+
+    // Ranges only widen
+    static double lowerBound(const State& seen, int channels, uint64_t) {
+        double midpoints[ChannelLayout::maxChannels];
+        return finalize(seen, channels, midpoints);
+    }
+};
+
+struct EntropyMetric {
+    using State = HistogramState;
+
+    template <int C>
+    static void accumulate(State& state, const uint8_t* samples) {
+        MeanAbsoluteDeviationMetric::accumulate<C>(state, samples);
+    }
+    static void merge(State& state, const State& other) { MeanAbsoluteDeviationMetric::merge(state, other); }
+
+    template <typename S>
+    static double finalize(const S& stats, int channels, double* means) {
+        VarianceMetric::meansOf(stats, channels, means);
+        if (stats.count == 0) return 0.0;
+
+        double maxEntropy = 8.0;
+        double total = 0;
+        for (int c = 0; c < channels; c++) {
+            const uint32_t* hist = &stats.histogram[c * 256];
+            for (int v = 0; v < 256; v++) {
+                if (!hist[v]) continue;
+                double prob = hist[v] / static_cast<double>(stats.count);
+                total -= prob * log2(prob);
+            }
+        }
+        return total / (channels * maxEntropy);
+    }
+
+    // Entropy is concave: mixing the seen distribution (weight count / total) with the rest
+    // cannot drop below that weight times the seen entropy
+    static double lowerBound(const State& seen, int channels, uint64_t total) {
+        double means[ChannelLayout::maxChannels];
+        return finalize(seen, channels, means) * seen.count / total;
+    }
+};
+
+struct SSIMMetric {
+    using State = MomentState;
+
+    template <int C>
+    static void accumulate(State& state, const uint8_t* samples) { state.template add<C>(samples); }
+    static void merge(State& state, const State& other) { state.merge(other); }
+
+    // Luminance-free SSIM of the block against its flat mean: 1 - mean over channels of C2 / (var + C2)
+    template <typename S>
+    static double finalize(const S& stats, int channels, double* means) {
+        const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+        VarianceMetric::meansOf(stats, channels, means);
+        if (stats.count == 0) return 0.0;
+
+        const double squaredCount = static_cast<double>(static_cast<ExactSum>(stats.count) * stats.count);
+        double ssim = 0;
+        for (int c = 0; c < channels; c++) {
+            double var = static_cast<double>(scaledSquaredDeviation(stats, c)) / squaredCount;
+            ssim += c2 / (var + c2);
+        }
+        return 1.0 - ssim / channels;
+    }
+
+    // The error grows with the variance, which is bounded below as for VarianceMetric
+    static double lowerBound(const State& seen, int channels, uint64_t total) {
+        const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+        double ssim = 0;
+        for (int c = 0; c < channels; c++) ssim += c2 / (squaredDeviation(seen, c) / total + c2);
+        return 1.0 - ssim / channels;
+    }
+};
+
+// C++17 detection of the metric interface above
+template <typename M, typename = void>
+struct IsBlockMetric : std::false_type {};
+
+template <typename M>
+struct IsBlockMetric<M, std::void_t<
+    typename M::State,
+    decltype(M::template accumulate<3>(std::declval<typename M::State&>(), std::declval<const uint8_t*>())),
+    decltype(M::merge(std::declval<typename M::State&>(), std::declval<const typename M::State&>())),
+    decltype(M::finalize(std::declval<const typename M::State&>(), 3, std::declval<double*>()))>>
+    : std::true_type {};
+
+template <typename M, typename = void>
+struct HasLowerBound : std::false_type {};
+
+template <typename M>
+struct HasLowerBound<M, std::void_t<
+    decltype(M::lowerBound(std::declval<const typename M::State&>(), 3, std::declval<uint64_t>()))>>
+    : std::true_type {};
+
+#endif
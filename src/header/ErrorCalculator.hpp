@@ -4,27 +4,40 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
-#include <map>
 #include <numeric>
 #include "ImagePixel.hpp"
+#include "StatisticsPyramid.hpp"
+#include "MomentImage.hpp"
+#include "BlockMetrics.hpp"
 class ErrorCalculator {
 public:
-    enum ErrorMethod {
+    // Fixed underlying type: metrics added through MetricRegistry take ids past PLANE_RESIDUAL
+    enum ErrorMethod : int {
         VARIANCE = 1,
         MEAN_ABSOLUTE_DEVIATION = 2,
         MAX_PIXEL_DIFFERENCE = 3,
         ENTROPY = 4,
-        SSIM = 5
+        SSIM = 5,
+        PLANE_RESIDUAL = 6
     };
     static double calculateError(ErrorMethod method, const std::vector<std::vector<Pixel>>& block, double& rValue, double& gValue, double& bValue);
+    // Same metrics evaluated from precomputed block statistics (see StatisticsPyramid), averaged over
+    // the stats.channels samples of the image layout; values receives one representative per sample.
+    // Any id known to MetricRegistry is accepted, including combined metrics
+    static double calculateError(ErrorMethod method, const BlockStatistics& stats, double* values);
+    static bool requiresHistogram(ErrorMethod method);
+    // Residual of the block against its least-squares plane, normalized like the variance
+    static double calculatePlaneResidual(const PlaneFit& fit, double* means);
 private:
     static double calculateVariance(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean);
     static double calculateMAD(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean);
     static double calculateMaxDiff(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean);
     static double calculateEntropy(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean);
     static double calculateSSIM(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean);
-    static void calculateMeans(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean);
-    static void calculateHistograms(const std::vector<std::vector<Pixel>>& block, std::map<uint8_t, int>& rHist, std::map<uint8_t, int>& gHist,std::map<uint8_t, int>& bHist);
+    static double calculatePlaneFit(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean);
+    // Single pass over the block with a compile-time metric
+    template <typename Metric>
+    static double evaluateBlock(const std::vector<std::vector<Pixel>>& block, double& rValue, double& gValue, double& bValue);
 };
 
 
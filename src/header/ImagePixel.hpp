@@ -5,6 +5,8 @@
 #include <string>
 #include <cstdint>
 #include <stdexcept>
+#include <type_traits>
+#include <memory>
 
 // Forward declarations from stb
 extern "C" {
@@ -14,13 +16,71 @@ extern "C" {
     int stbi_write_jpg(char const* filename, int w, int h, int comp, const void* data, int quality);
 }
 
-// Represents a single pixel with RGB channels
+// Represents a single pixel with RGB channels and alpha
 struct Pixel {
-    uint8_t r, g, b;
-    Pixel() : r(0), g(0), b(0) {}
-    Pixel(uint8_t red, uint8_t green, uint8_t blue) : r(red), g(green), b(blue) {}
+    uint8_t r, g, b, a;
+    Pixel() : r(0), g(0), b(0), a(255) {}
+    Pixel(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = 255) : r(red), g(green), b(blue), a(alpha) {}
+    // Component by index: 0 = r, 1 = g, 2 = b, 3 = a
+    uint8_t operator[](int index) const { return index == 0 ? r : index == 1 ? g : index == 2 ? b : a; }
+    bool operator==(const Pixel& other) const { return r == other.r && g == other.g && b == other.b && a == other.a; }
+    bool operator!=(const Pixel& other) const { return !(*this == other); }
 };
 
+// Channel layouts as stored in image files: 1 = gray, 2 = gray + alpha, 3 = RGB, 4 = RGBA.
+// Images keep only the samples their layout carries (see ImagePixel). As a Pixel, a gray sample
+// fills r, g and b alike and alpha is 255 for layouts without it.
+struct ChannelLayout {
+    static const int maxChannels = 4;
+
+    // Samples of p carried by layout C, in layout order
+    template <int C>
+    static void extract(const Pixel& p, uint8_t* samples) {
+        if constexpr (C <= 2) {
+            samples[0] = p.r;
+            if constexpr (C == 2) samples[1] = p.a;
+        } else {
+            samples[0] = p.r;
+            samples[1] = p.g;
+            samples[2] = p.b;
+            if constexpr (C == 4) samples[3] = p.a;
+        }
+    }
+
+    static void extract(const Pixel& p, int channels, uint8_t* samples) {
+        dispatch(channels, [&](auto layout) { extract<decltype(layout)::value>(p, samples); });
+    }
+
+    static Pixel compose(const uint8_t* samples, int channels) {
+        switch (channels) {
+            case 1: return Pixel(samples[0], samples[0], samples[0]);
+            case 2: return Pixel(samples[0], samples[0], samples[0], samples[1]);
+            case 3: return Pixel(samples[0], samples[1], samples[2]);
+            case 4: return Pixel(samples[0], samples[1], samples[2], samples[3]);
+            default: throw std::invalid_argument("Unsupported channel count");
+        }
+    }
+
+    // Pixel component (see Pixel::operator[]) holding a layout sample
+    static int component(int channels, int sample) {
+        return (channels == 2 && sample == 1) ? 3 : sample;
+    }
+
+    // Calls body with std::integral_constant<int, channels>, instantiating kernels per layout
+    template <typename Body>
+    static void dispatch(int channels, Body&& body) {
+        switch (channels) {
+            case 1: body(std::integral_constant<int, 1>()); break;
+            case 2: body(std::integral_constant<int, 2>()); break;
+            case 3: body(std::integral_constant<int, 3>()); break;
+            case 4: body(std::integral_constant<int, 4>()); break;
+            default: throw std::invalid_argument("Unsupported channel count");
+        }
+    }
+};
+
+class MortonTiles;
+
 class ImagePixel {
 public:
     ImagePixel();
@@ -29,16 +89,31 @@ public:
     bool saveImage(const std::string& filepath) const;
     int getWidth() const;
     int getHeight() const;
-    const std::vector<std::vector<Pixel>>& getPixelMatrix() const;
-    std::vector<std::vector<Pixel>>& getPixelMatrix();
+    // Channel layout of the source file, kept when saving (see ChannelLayout)
+    int getChannels() const;
+    // Samples in the image's channel layout, pixel after pixel and row after row: a pixel is
+    // getChannels() bytes and a row getWidth() * getChannels()
+    const std::vector<uint8_t>& getSamples() const;
+    const uint8_t* getRow(int y) const;
     Pixel getPixel(int x, int y) const;
     void setPixel(int x, int y, const Pixel& pixel);
-    void createFromMatrix(const std::vector<std::vector<Pixel>>& matrix);
+    // Sets pixels [left, right) of row y to one color
+    void fillSpan(int y, int left, int right, const Pixel& color);
+    // Opaque black image of the given size and layout
+    void create(int width, int height, int channels = 3);
+    // Takes over width * height pixels of interleaved samples
+    void createFromSamples(std::vector<uint8_t>&& samples, int width, int height, int channels);
+    // Optional Z-order storage next to the rows, read by the block scanners when present (see
+    // MortonTiles). Any change to the pixels drops it
+    void enableMortonTiles();
+    const MortonTiles* getMortonTiles() const;
     
 private:
-    std::vector<std::vector<Pixel>> pixelMatrix;
+    std::vector<uint8_t> samples;
     int width;
     int height;
+    int channels;
+    std::shared_ptr<const MortonTiles> mortonTiles;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef LINEAR_QUADTREE_H
+#define LINEAR_QUADTREE_H
+
+#include "QuadTreeNode.hpp"
+#include <vector>
+#include <cstdint>
+#include <string>
+
+// One leaf of a linear quadtree. code is the leaf's quadrant path from the root, two bits per level
+// (0 NW, 1 NE, 2 SW, 3 SE) starting at the top bits, so sorting by code is sorting in Z-order
+struct LinearLeaf {
+    uint64_t code;
+    uint32_t level;  // depth below the root, 0 for a single-leaf tree
+    Pixel color;
+};
+static_assert(sizeof(LinearLeaf) == 16, "LinearLeaf is stored as a raw 16-byte record");
+
+// Pointerless quadtree: only the leaves, as LinearLeaf records sorted by code. Block geometry is
+// implied by the image size, since quad splits always halve a block the same way (see
+// QuadTreeCompressor::splitBlock), so a leaf costs 16 bytes and the array can be written, mapped
+// or shared as is. Point and region queries binary search the codes. Covers quad-split trees with
+// flat leaves.
+class LinearQuadTree {
+public:
+    static const int maxLevels = 31;
+
+    LinearQuadTree();
+    // Throws std::invalid_argument unless the leaves, in code order, tile the whole image with
+    // blocks of at least one pixel
+    LinearQuadTree(int width, int height, int channels, std::vector<LinearLeaf> leaves);
+
+    static LinearQuadTree fromTree(const QuadTreeNode* root, int width, int height, int channels = 3);
+    // Merges bottom-up over the full quad subdivision: a block replaces its children's leaves when
+    // its own error is within the threshold, which gives the same leaves as the top-down build
+    static LinearQuadTree buildBottomUp(const StatisticsPyramid& pyramid, ErrorCalculator::ErrorMethod method,
+                                        double threshold, int minBlockSize);
+
+    int getWidth() const;
+    int getHeight() const;
+    int getChannels() const;
+    const std::vector<LinearLeaf>& getLeaves() const;
+    size_t memoryBytes() const;
+
+    BlockRect blockOf(const LinearLeaf& leaf) const;
+    // Leaf covering pixel (x, y); throws std::out_of_range outside the image
+    const LinearLeaf& leafAt(int x, int y) const;
+    // Indices of the leaves intersecting rect, in Z-order
+    void leavesInRect(const BlockRect& rect, std::vector<size_t>& indices) const;
+    void reconstruct(ImagePixel& outputImage) const;
+
+    // "QTL1", width, height, channels, leaf count (uint32 little endian), then the raw records.
+    // Loading returns false when the file cannot be read, and throws std::invalid_argument when
+    // its header or leaves are inconsistent
+    bool saveToFile(const std::string& filepath) const;
+    static bool loadFromFile(const std::string& filepath, LinearQuadTree& tree);
+
+private:
+    int width;
+    int height;
+    int channels;
+    std::vector<LinearLeaf> leaves;
+
+    static uint64_t childCode(uint64_t code, int level, int quadrant);
+    static uint64_t span(int level);
+    static BlockRect childBlock(const BlockRect& block, int quadrant);
+    // Range of leaves whose code lies under the node (code, level)
+    std::pair<size_t, size_t> leafRange(uint64_t code, int level) const;
+    void collectInRect(const BlockRect& block, uint64_t code, int level, const BlockRect& rect,
+                       std::vector<size_t>& indices) const;
+    static void appendTree(const QuadTreeNode* node, uint64_t code, int level, std::vector<LinearLeaf>& leaves);
+    static void mergeBottomUp(const StatisticsPyramid& pyramid, ErrorCalculator::ErrorMethod method,
+                              double threshold, int minBlockSize, const BlockRect& block, uint64_t code,
+                              int level, BlockStatistics& stats, std::vector<LinearLeaf>& leaves);
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef METRIC_REGISTRY_H
+#define METRIC_REGISTRY_H
+
+#include <string>
+#include <vector>
+#include "StatisticsPyramid.hpp"
+
+// Sufficient statistics a metric reads from BlockStatistics
+enum BlockStatisticsNeed : unsigned {
+    SUM_STATISTICS = 1,        // count and per-channel sums
+    SQUARE_STATISTICS = 2,     // per-channel sums of squares
+    RANGE_STATISTICS = 4,      // per-channel min and max
+    HISTOGRAM_STATISTICS = 8,  // 256 bins per channel
+    PLANE_STATISTICS = 16      // coordinate moments, evaluated through MomentImage instead
+};
+
+struct MetricDescriptor {
+    int id;                       // value used as ErrorCalculator::ErrorMethod
+    std::string key;              // short name, e.g. "variance" or "variance+maxdiff"
+    std::string label;            // menu text
+    unsigned statistics;          // BlockStatisticsNeed bits
+    // Error in [0, 1] and one representative value per channel; null for plane fits
+    double (*evaluate)(const BlockStatistics& stats, double* values);
+    std::vector<int> components;  // ids of the metrics a combined metric takes the maximum of
+};
+
+// Error metrics by id. The built-in methods keep their ErrorMethod numbers (1-6); new metrics are
+// added with a statistics evaluator and get the next free id. A combined metric takes the largest
+// error of its components, so a block only stays a leaf when every component accepts it, and all
+// components read the same BlockStatistics: one pyramid query or scan serves them all.
+// Register metrics before compressing; ids stay valid, descriptor references may not.
+class MetricRegistry {
+public:
+    static int add(const std::string& key, const std::string& label, unsigned statistics,
+                   double (*evaluate)(const BlockStatistics&, double*));
+    // Returns the id of the combination, registering it on first use
+    static int combine(const std::vector<int>& ids);
+    // Accepts ids or keys joined by '+', such as "3", "entropy" or "1+maxdiff"
+    static int parse(const std::string& spec);
+
+    static const MetricDescriptor& get(int id);
+    static const MetricDescriptor* find(const std::string& key);
+    static const std::vector<MetricDescriptor>& all();
+    static double evaluate(int id, const BlockStatistics& stats, double* values);
+    static unsigned statisticsOf(int id);
+
+private:
+    static std::vector<MetricDescriptor>& entries();
+    static double evaluateCombined(const MetricDescriptor& metric, const BlockStatistics& stats, double* values);
+};
+
+#endif
@@ -0,0 +1,314 @@
+#ifndef METRIC_TREE_BUILDER_H
+#define METRIC_TREE_BUILDER_H
+
+#include "QuadTreeNode.hpp"
+#include "BlockMetrics.hpp"
+#include "MortonTiles.hpp"
+#include "Parallel.hpp"
+#include <vector>
+
+// Quad splitting, flat leaves, with the error metric fixed at compile time (see BlockMetrics.hpp).
+// Each split block is scanned once, quadrant by quadrant, and the quadrant states become the
+// children's statistics, so a leaf costs no scan of its own. The metric's accumulate runs inline
+// in the pixel loop and no per-node dispatch remains. Builds the same tree as QuadTreeCompressor
+// with the matching ErrorMethod.
+//
+// Bounded mode scans every block itself instead, row by row, and stops as soon as the metric's
+// lowerBound proves the block splits, so busy blocks near the root cost a few rows. The full
+// statistics of a stopped block are merged back from its children, which keeps the tree and every
+// node's error and color identical to the unbounded build.
+//
+// Partitioned mode builds the root's four quadrants on four workers, each pinned to its own CPU
+// and spread across the machine. A worker copies its quadrant out of the shared rows and builds the
+// quadrant's subtree from that copy. Pages land on the NUMA node of the thread that first writes
+// them, so the copy, its Morton tiles and the subtree's nodes (from the worker's own malloc arena)
+// stay local to the core that scans them. The root is finished from the quadrants' statistics.
+template <typename Metric>
+class MetricTreeBuilder {
+    static_assert(IsBlockMetric<Metric>::value, "Metric must provide State, accumulate, merge and finalize");
+
+public:
+    MetricTreeBuilder(const ImagePixel& image, double threshold, int minBlockSize, bool bounded = false,
+                      bool partitioned = false)
+        : image(image), threshold(threshold), minBlockSize(minBlockSize), bounded(bounded), partitioned(partitioned),
+          originX(0), originY(0), treeDepth(0), nodeCount(0) {}
+
+    std::unique_ptr<QuadTreeNode> build() {
+        treeDepth = 0;
+        nodeCount = 0;
+        std::unique_ptr<QuadTreeNode> root;
+        ChannelLayout::dispatch(image.getChannels(), [&](auto layout) {
+            constexpr int C = decltype(layout)::value;
+            BlockRect whole = {0, 0, image.getWidth(), image.getHeight()};
+            BlockState state;
+            if (partitioned && QuadTreeCompressor::canSplit(whole.width, whole.height, minBlockSize)) {
+                root = buildPartitioned<C>(whole);
+            } else {
+                root = buildRoot<C>(whole, state);
+            }
+        });
+        return root;
+    }
+
+    int getTreeDepth() const { return treeDepth; }
+    int getNodeCount() const { return nodeCount; }
+
+private:
+    using State = typename Metric::State;
+    // The leaves' squared error needs sums of squares; states without them carry a MomentState alongside
+    static constexpr bool stateHasMoments = std::is_base_of<MomentState, State>::value;
+
+    struct BlockState {
+        State metric;
+        MomentState moments;
+    };
+
+    const ImagePixel& image;
+    double threshold;
+    int minBlockSize;
+    bool bounded;
+    bool partitioned;
+    // Position of the image within the full image, added to every node (see buildPartitioned)
+    int originX, originY;
+    int treeDepth;
+    int nodeCount;
+
+    static const MomentState& momentsOf(const BlockState& state) {
+        if constexpr (stateHasMoments) return state.metric;
+        else return state.moments;
+    }
+
+    static void mergeState(BlockState& state, const BlockState& other) {
+        Metric::merge(state.metric, other.metric);
+        if constexpr (!stateHasMoments) state.moments.merge(other.moments);
+    }
+
+    // Same quadrant geometry as QuadTreeCompressor::splitBlock
+    static void quadrants(const BlockRect& block, BlockRect children[4]) {
+        int halfWidth = block.width / 2;
+        int halfHeight = block.height / 2;
+        children[0] = BlockRect{block.x, block.y, halfWidth, halfHeight};
+        children[1] = BlockRect{block.x + halfWidth, block.y, block.width - halfWidth, halfHeight};
+        children[2] = BlockRect{block.x, block.y + halfHeight, halfWidth, block.height - halfHeight};
+        children[3] = BlockRect{block.x + halfWidth, block.y + halfHeight, block.width - halfWidth, block.height - halfHeight};
+    }
+
+    template <int C>
+    static void accumulatePixel(BlockState& state, const uint8_t* samples) {
+        Metric::template accumulate<C>(state.metric, samples);
+        if constexpr (!stateHasMoments) state.moments.template add<C>(samples);
+    }
+
+    // Reads the image's Z-order tiles when it has them, its rows otherwise
+    template <int C>
+    void scan(const BlockRect& block, BlockState& state) const {
+        if (const MortonTiles* tiles = image.getMortonTiles()) {
+            tiles->forEachRun(block.x, block.y, block.width, block.height, [&](const uint8_t* run, size_t count) {
+                for (size_t i = 0; i < count; i++) accumulatePixel<C>(state, run + i * C);
+                return true;
+            });
+            return;
+        }
+        for (int y = block.y; y < block.y + block.height; y++) {
+            const uint8_t* row = image.getRow(y);
+            for (int x = block.x; x < block.x + block.width; x++) accumulatePixel<C>(state, row + x * C);
+        }
+    }
+
+    // Scans until the bound exceeds the threshold; false when the scan stopped early. The bound is
+    // checked after 1, 2, 4, ... rows' worth of pixels, so histogram bounds stay cheap on narrow
+    // blocks, with a small slack that absorbs rounding between the bound and finalize
+    template <int C>
+    bool scanBounded(const BlockRect& block, BlockState& state) const {
+        const double boundSlack = 1e-9;
+        const uint64_t total = static_cast<uint64_t>(block.width) * block.height;
+        uint64_t seen = 0;
+        uint64_t nextCheck = block.width;
+        auto exceeded = [&]() {
+            if (seen < nextCheck || seen >= total) return false;
+            while (nextCheck <= seen) nextCheck *= 2;
+            return Metric::lowerBound(state.metric, C, total) > threshold + boundSlack;
+        };
+
+        if (const MortonTiles* tiles = image.getMortonTiles()) {
+            // Runs are cut at the checkpoints, so a block inside one run can still stop early
+            return tiles->forEachRun(block.x, block.y, block.width, block.height, [&](const uint8_t* run, size_t count) {
+                for (size_t i = 0; i < count;) {
+                    size_t end = std::min<size_t>(count, i + std::max<uint64_t>(nextCheck - std::min(seen, nextCheck), 1));
+                    seen += end - i;
+                    for (; i < end; i++) accumulatePixel<C>(state, run + i * C);
+                    if (exceeded()) return false;
+                }
+                return true;
+            });
+        }
+        for (int y = block.y; y < block.y + block.height; y++) {
+            const uint8_t* row = image.getRow(y);
+            for (int x = block.x; x < block.x + block.width; x++) accumulatePixel<C>(state, row + x * C);
+            seen += block.width;
+            if (exceeded()) return false;
+        }
+        return true;
+    }
+
+    std::unique_ptr<QuadTreeNode> makeNode(const BlockRect& block) const {
+        return std::make_unique<QuadTreeNode>(block.x + originX, block.y + originY, block.width, block.height);
+    }
+
+    // Builds the tree of the whole image; fills state with its full statistics on return
+    template <int C>
+    std::unique_ptr<QuadTreeNode> buildRoot(const BlockRect& whole, BlockState& state) {
+        if constexpr (HasLowerBound<Metric>::value) {
+            if (bounded) return buildBounded<C>(whole, state, 1);
+        }
+        if (!QuadTreeCompressor::canSplit(whole.width, whole.height, minBlockSize)) {
+            scan<C>(whole, state);
+            return buildNode<C>(whole, state, 1, nullptr);
+        }
+        // The root's statistics are merged from its quadrants, which are kept for the children
+        std::vector<BlockState> quadrantStates(4);
+        BlockRect quadrant[4];
+        quadrants(whole, quadrant);
+        for (int i = 0; i < 4; i++) {
+            scan<C>(quadrant[i], quadrantStates[i]);
+            mergeState(state, quadrantStates[i]);
+        }
+        return buildNode<C>(whole, state, 1, quadrantStates.data());
+    }
+
+    // Each quadrant's subtree is built by its own worker before the root's error is known, so a
+    // root that turns out to be a leaf wastes that work; the tree is the same either way
+    template <int C>
+    std::unique_ptr<QuadTreeNode> buildPartitioned(const BlockRect& whole) {
+        const int parts = 4;
+        BlockRect quadrant[parts];
+        quadrants(whole, quadrant);
+        BlockState states[parts];
+        std::unique_ptr<QuadTreeNode> subtrees[parts];
+        int depths[parts] = {}, counts[parts] = {};
+
+        Parallel::forChunks(0, parts, parts, [&](int i, int, int) {
+            Parallel::CoreAffinity affinity(i, parts);
+            const BlockRect& block = quadrant[i];
+            const size_t rowSamples = static_cast<size_t>(block.width) * C;
+            std::vector<uint8_t> samples(rowSamples * block.height);
+            for (int y = 0; y < block.height; y++) {
+                const uint8_t* source = image.getRow(block.y + y) + static_cast<size_t>(block.x) * C;
+                std::copy(source, source + rowSamples, samples.begin() + y * rowSamples);
+            }
+            ImagePixel local;
+            local.createFromSamples(std::move(samples), block.width, block.height, C);
+            if (image.getMortonTiles()) local.enableMortonTiles();
+
+            MetricTreeBuilder part(local, threshold, minBlockSize, bounded);
+            part.originX = block.x;
+            part.originY = block.y;
+            subtrees[i] = part.template buildRoot<C>(BlockRect{0, 0, block.width, block.height}, states[i]);
+            depths[i] = part.treeDepth;
+            counts[i] = part.nodeCount;
+        });
+
+        BlockState state;
+        for (int i = 0; i < parts; i++) mergeState(state, states[i]);
+        auto node = makeNode(whole);
+        nodeCount = 1;
+        treeDepth = 1;
+        finishNode<C>(*node, state);
+        if (node->error <= threshold) {
+            node->isLeaf = true;
+            return node;
+        }
+        for (int i = 0; i < parts; i++) {
+            node->children[i] = std::move(subtrees[i]);
+            nodeCount += counts[i];
+            treeDepth = std::max(treeDepth, depths[i] + 1);
+        }
+        return node;
+    }
+
+    // Fills state with the block's full statistics on return
+    template <int C>
+    std::unique_ptr<QuadTreeNode> buildBounded(const BlockRect& block, BlockState& state, int depth) {
+        auto node = makeNode(block);
+        nodeCount++;
+        treeDepth = std::max(treeDepth, depth);
+
+        bool splittable = QuadTreeCompressor::canSplit(block.width, block.height, minBlockSize);
+        bool complete = true;
+        if (splittable) complete = scanBounded<C>(block, state);
+        else scan<C>(block, state);
+        if (complete) {
+            finishNode<C>(*node, state);
+            if (node->error <= threshold || !splittable) {
+                node->isLeaf = true;
+                return node;
+            }
+        }
+
+        BlockRect children[4];
+        quadrants(block, children);
+        if (!complete) state = BlockState();
+        for (int i = 0; i < 4; i++) {
+            BlockState childState;
+            node->children[i] = buildBounded<C>(children[i], childState, depth + 1);
+            if (!complete) mergeState(state, childState);
+        }
+        if (!complete) finishNode<C>(*node, state);
+        return node;
+    }
+
+    // Error, color and squared error of a node from its block's full statistics
+    template <int C>
+    void finishNode(QuadTreeNode& node, const BlockState& state) const {
+        double values[ChannelLayout::maxChannels];
+        uint8_t samples[ChannelLayout::maxChannels];
+        node.error = Metric::finalize(state.metric, C, values);
+        for (int c = 0; c < C; c++) samples[c] = static_cast<uint8_t>(values[c]);
+        node.averageColor = ChannelLayout::compose(samples, C);
+
+        const MomentState& moments = momentsOf(state);
+        uint64_t squaredError = 0;
+        for (int c = 0; c < C; c++) squaredError += squaredErrorAround(moments, c, samples[c]);
+        node.squaredError = static_cast<double>(squaredError);
+    }
+
+    template <int C>
+    std::unique_ptr<QuadTreeNode> buildNode(const BlockRect& block, const BlockState& state, int depth,
+                                            BlockState* childStates) {
+        auto node = makeNode(block);
+        nodeCount++;
+        treeDepth = std::max(treeDepth, depth);
+        finishNode<C>(*node, state);
+
+        if (node->error <= threshold || !QuadTreeCompressor::canSplit(block.width, block.height, minBlockSize)) {
+            node->isLeaf = true;
+            return node;
+        }
+
+        BlockRect children[4];
+        quadrants(block, children);
+        std::vector<BlockState> scanned;
+        if (!childStates) {
+            scanned.resize(4);
+            for (int i = 0; i < 4; i++) scan<C>(children[i], scanned[i]);
+            childStates = scanned.data();
+        }
+        // A child that splits again scans its own children in turn
+        for (int i = 0; i < 4; i++) {
+            node->children[i] = buildNode<C>(children[i], childStates[i], depth + 1, nullptr);
+        }
+        return node;
+    }
+};
+
+template <typename Metric>
+void QuadTreeCompressor::compressWith(bool bounded) {
+    root.reset();
+    palette.clear();
+    MetricTreeBuilder<Metric> builder(image, threshold, minBlockSize, bounded, partitioned);
+    root = builder.build();
+    treeDepth = builder.getTreeDepth();
+    nodeCount = builder.getNodeCount();
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef MOMENT_IMAGE_H
+#define MOMENT_IMAGE_H
+
+#include "ImagePixel.hpp"
+#include "StatisticsPyramid.hpp"
+#include <vector>
+#include <cstdint>
+
+// Least-squares plane v = mean + gradientX * (x - cx) + gradientY * (y - cy) per channel,
+// with (cx, cy) the block center
+struct PlaneFit {
+    int channels;        // samples per pixel of the image layout, see ChannelLayout
+    uint64_t count;
+    double mean[ChannelLayout::maxChannels];
+    double gradientX[ChannelLayout::maxChannels];
+    double gradientY[ChannelLayout::maxChannels];
+    double residual[ChannelLayout::maxChannels];  // sum of squared residuals against the plane
+    double sumXX, sumYY; // sums of squared centered coordinates
+};
+
+// Integral images of x*v and y*v per channel. Together with the block sums from the
+// pyramid they give the plane fit of any rectangle in O(1): on a full pixel grid the
+// centered coordinates are uncorrelated, so each gradient is a single moment ratio.
+class MomentImage {
+public:
+    explicit MomentImage(const ImagePixel& image);
+
+    PlaneFit fit(int x, int y, int width, int height, const BlockStatistics& stats) const;
+
+private:
+    int width, height, channels;
+    // (width + 1) x (height + 1) tables, channels interleaved
+    std::vector<int64_t> sumXV;
+    std::vector<int64_t> sumYV;
+
+    template <int C> void build(const ImagePixel& image);
+
+    int64_t rectSum(const std::vector<int64_t>& table, int x0, int y0, int x1, int y1, int channel) const;
+};
+
+#endif
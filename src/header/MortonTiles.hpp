@@ -0,0 +1,100 @@
+#ifndef MORTON_TILES_H
+#define MORTON_TILES_H
+
+#include "ImagePixel.hpp"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// Z-order copy of an image's samples: 64x64 tiles in row-major order, the pixels of each tile in
+// Morton order, each pixel getChannels() bytes as in ImagePixel. Any aligned power-of-two square
+// inside a tile is one contiguous run, so the blocks of a quadtree recursion map to a handful of
+// runs instead of rows scattered across the image. Edge tiles are padded; padding pixels are never
+// visited.
+class MortonTiles {
+public:
+    static const int tileShift = 6;
+    static const int tileSize = 1 << tileShift;
+    static const int tilePixels = tileSize * tileSize;
+
+    explicit MortonTiles(const ImagePixel& image);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getChannels() const { return channels; }
+    const uint8_t* at(int x, int y) const { return &samples[offsetOf(x, y) * channels]; }
+
+    size_t offsetOf(int x, int y) const {
+        size_t tile = static_cast<size_t>(y >> tileShift) * tilesAcross + (x >> tileShift);
+        return tile * tilePixels + interleave(x & (tileSize - 1), y & (tileSize - 1));
+    }
+
+    // Morton index of (x, y) inside a tile: x bits in the even positions, y bits in the odd ones
+    static uint32_t interleave(uint32_t x, uint32_t y) { return spread(x) | (spread(y) << 1); }
+
+    // Visits the pixels of a block as contiguous runs, visit(const uint8_t* run, size_t count) with
+    // the samples of count pixels from run on, tile by tile and in Z-order inside each tile, which
+    // is the quadtree's NW, NE, SW, SE order.
+    // visit returns false to stop; forEachRun then returns false as well
+    template <typename Visit>
+    bool forEachRun(int x, int y, int blockWidth, int blockHeight, Visit&& visit) const {
+        if (blockWidth <= 0 || blockHeight <= 0) return true;
+        const int x1 = x + blockWidth, y1 = y + blockHeight;
+        for (int ty = y >> tileShift; ty <= (y1 - 1) >> tileShift; ty++) {
+            for (int tx = x >> tileShift; tx <= (x1 - 1) >> tileShift; tx++) {
+                const uint8_t* tile = &samples[(static_cast<size_t>(ty) * tilesAcross + tx) * tilePixels * channels];
+                // Block bounds relative to the tile, clamped to it
+                int left = std::max(x - (tx << tileShift), 0), right = std::min(x1 - (tx << tileShift), tileSize);
+                int top = std::max(y - (ty << tileShift), 0), bottom = std::min(y1 - (ty << tileShift), tileSize);
+                // Start from the smallest aligned square holding the block's part of the tile
+                int size = 1;
+                while (((left ^ (right - 1)) | (top ^ (bottom - 1))) >= size) size *= 2;
+                int sx = left & ~(size - 1), sy = top & ~(size - 1);
+                if (!visitSquare(tile, sx, sy, size, left, top, right, bottom, visit)) return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    int width, height, channels;
+    int tilesAcross;
+    std::vector<uint8_t> samples;
+
+    static uint32_t spread(uint32_t v) {
+        v = (v | (v << 8)) & 0x00FF00FFu;
+        v = (v | (v << 4)) & 0x0F0F0F0Fu;
+        v = (v | (v << 2)) & 0x33333333u;
+        v = (v | (v << 1)) & 0x55555555u;
+        return v;
+    }
+
+    // Emits the square as one run when the block covers it, otherwise recurses into its quadrants.
+    // Partly covered squares of smallSquare pixels or less are walked pixel by pixel instead, which
+    // keeps the recursion off the ragged edges of unaligned blocks
+    template <typename Visit>
+    bool visitSquare(const uint8_t* tile, int sx, int sy, int size,
+                     int left, int top, int right, int bottom, Visit& visit) const {
+        const int smallSquare = 8;
+        if (sx >= right || sy >= bottom || sx + size <= left || sy + size <= top) return true;
+        if (sx >= left && sy >= top && sx + size <= right && sy + size <= bottom) {
+            return visit(tile + interleave(sx, sy) * channels, static_cast<size_t>(size) * size);
+        }
+        if (size <= smallSquare) {
+            int x0 = std::max(sx, left), x1 = std::min(sx + size, right);
+            for (int y = std::max(sy, top); y < std::min(sy + size, bottom); y++) {
+                for (int x = x0; x < x1; x++) {
+                    if (!visit(tile + interleave(x, y) * channels, 1)) return false;
+                }
+            }
+            return true;
+        }
+        int half = size / 2;
+        return visitSquare(tile, sx, sy, half, left, top, right, bottom, visit) &&
+               visitSquare(tile, sx + half, sy, half, left, top, right, bottom, visit) &&
+               visitSquare(tile, sx, sy + half, half, left, top, right, bottom, visit) &&
+               visitSquare(tile, sx + half, sy + half, half, left, top, right, bottom, visit);
+    }
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef PALETTE_QUANTIZER_H
+#define PALETTE_QUANTIZER_H
+
+#include "ImagePixel.hpp"
+#include <vector>
+#include <cstdint>
+
+// Reduces a weighted set of colors (e.g. leaf colors weighted by leaf area) to a palette:
+// a weighted median cut seeds the entries, then a few k-means passes refine them. Colors are
+// clustered on all four components; alpha is constant for opaque layouts and gray samples are
+// equal in r, g and b, so neither changes the result for them.
+class PaletteQuantizer {
+public:
+    // assignment[i] receives the palette index chosen for colors[i]; paletteSize must be in 2-256
+    static std::vector<Pixel> build(const std::vector<Pixel>& colors, const std::vector<uint64_t>& weights,
+                                    int paletteSize, std::vector<int>& assignment);
+
+private:
+    struct WeightedColor {
+        int value[4];
+        uint64_t weight;
+    };
+
+    static const int refinePasses = 8;
+
+    static std::vector<Pixel> medianCut(std::vector<WeightedColor>& colors, int paletteSize);
+    static int nearest(const std::vector<Pixel>& palette, const int value[4]);
+};
+
+#endif
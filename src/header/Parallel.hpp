@@ -0,0 +1,103 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Work is cut into chunks by the caller and run on up to threadLimit() threads. How the work is cut
+// never depends on the thread count, so results merged in chunk order (and chunk counts taken from
+// fixedChunks) are the same for any number of threads, including one.
+class Parallel {
+public:
+    // Threads to run on: the hardware's, or the limit set with setThreadLimit
+    static int threadLimit() {
+        if (threadOverride > 0) return threadOverride;
+        int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        return hardware > 0 ? hardware : 1;
+    }
+    // 0 restores the hardware thread count; 1 runs every chunk on the calling thread
+    static void setThreadLimit(int threads) { threadOverride = std::max(threads, 0); }
+
+    // Number of worker threads to use for a range of the given size
+    static int workerCount(int items) {
+        return std::max(1, std::min(threadLimit(), items));
+    }
+
+    // Chunks of about itemsPerChunk items each, for layouts that must not follow the thread count
+    static int fixedChunks(int items, int itemsPerChunk) {
+        return std::max(1, (items + itemsPerChunk - 1) / itemsPerChunk);
+    }
+
+    // Splits [begin, end) into `chunks` contiguous ranges and runs body(chunkBegin, chunkEnd, chunkIndex)
+    // for each, on up to threadLimit() threads; thread t takes chunks t, t + threads, ... Chunk bounds
+    // depend only on the range and the chunk count, so callers can merge per-chunk partial results in
+    // index order.
+    template <typename Body>
+    static void forChunks(int begin, int end, int chunks, Body body) {
+        if (end <= begin) return;
+        chunks = std::max(1, std::min(chunks, end - begin));
+        const int threads = std::min(chunks, threadLimit());
+        auto run = [&](int first) {
+            for (int i = first; i < chunks; i += threads) {
+                body(chunkBegin(begin, end, chunks, i), chunkBegin(begin, end, chunks, i + 1), i);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (int t = 1; t < threads; t++) workers.emplace_back(run, t);
+        run(0);
+        for (auto& worker : workers) worker.join();
+    }
+
+    static int chunkBegin(int begin, int end, int chunks, int index) {
+        return begin + static_cast<int>(static_cast<long long>(end - begin) * index / chunks);
+    }
+
+    // Pins the calling thread to one CPU for its lifetime and restores the previous affinity after.
+    // Worker `index` of `workers` gets the CPU at the same fraction of the thread's allowed set, so
+    // workers spread across sockets when CPUs are numbered socket by socket. No-op off Linux
+    class CoreAffinity {
+    public:
+        CoreAffinity(int index, int workers) : pinned(false) {
+#ifdef __linux__
+            if (pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) != 0) return;
+            std::vector<int> allowed;
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &previous)) allowed.push_back(cpu);
+            }
+            if (allowed.empty() || workers <= 0) return;
+            cpu_set_t target;
+            CPU_ZERO(&target);
+            CPU_SET(allowed[static_cast<size_t>(index) * allowed.size() / workers], &target);
+            pinned = pthread_setaffinity_np(pthread_self(), sizeof(target), &target) == 0;
+#else
+            (void)index;
+            (void)workers;
+#endif
+        }
+        ~CoreAffinity() {
+#ifdef __linux__
+            if (pinned) pthread_setaffinity_np(pthread_self(), sizeof(previous), &previous);
+#endif
+        }
+        CoreAffinity(const CoreAffinity&) = delete;
+        CoreAffinity& operator=(const CoreAffinity&) = delete;
+
+    private:
+        bool pinned;
+#ifdef __linux__
+        cpu_set_t previous;
+#endif
+    };
+
+private:
+    static inline int threadOverride = 0;
+};
+
+#endif
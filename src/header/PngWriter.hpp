@@ -0,0 +1,82 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include "ImagePixel.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+
+// PNG encoder that deflates the image in independent row stripes, spread over the worker threads.
+// Each stripe is filtered and compressed on its own (no match window across stripes) and ends
+// on a byte boundary with an empty stored block, so the stripes concatenate into one zlib stream;
+// their Adler-32 sums are combined at the end. Every stripe goes out as its own IDAT chunk, which
+// keeps the chunk CRCs in the workers too. The compressor uses the fixed Huffman codes with a
+// hash-table LZ77 matcher; the result decodes with any PNG reader. The stripe layout depends only
+// on the image, so the bytes are the same for any thread count.
+class PngWriter {
+public:
+    enum Level {
+        STORED_LEVEL = 0,   // no compression, only filtering
+        FAST_LEVEL = 1,     // Up filter, one match candidate per position
+        DEFAULT_LEVEL = 2   // per-row adaptive filter, short match chains
+    };
+
+    // PNG row filters, plus two hints for a FilterSource: ADAPTIVE_FILTER leaves the choice to the
+    // level, REPEATED_ROW declares a row equal to the one above, which is then written as an
+    // all-zero Up row without asking the row source for it
+    enum RowFilter {
+        ADAPTIVE_FILTER = -1,
+        NONE_FILTER = 0,
+        SUB_FILTER = 1,
+        UP_FILTER = 2,
+        AVERAGE_FILTER = 3,
+        PAETH_FILTER = 4,
+        REPEATED_ROW = 5
+    };
+
+    // Fills the unfiltered scanline y (width * channels * bitDepth / 8 bytes, samples big endian).
+    // Called from several threads at once, for different rows
+    using RowSource = std::function<void(int y, uint8_t* row)>;
+    // Filter for scanline y, for callers that know the image's structure; also called concurrently
+    using FilterSource = std::function<RowFilter(int y)>;
+
+    // channels follow ChannelLayout (1 gray, 2 gray + alpha, 3 RGB, 4 RGBA); bitDepth is 8 or 16
+    PngWriter(int width, int height, int channels, int bitDepth = 8);
+
+    void setLevel(Level level);
+    // Number of row stripes, 0 for one per defaultStripeRows rows
+    void setStripes(int stripes);
+    void setFilterSource(FilterSource filters);
+
+    std::vector<uint8_t> encode(const RowSource& rows) const;
+    bool write(const std::string& filepath, const RowSource& rows) const;
+    static bool writeImage(const std::string& filepath, const ImagePixel& image,
+                           Level level = DEFAULT_LEVEL, int stripes = 0);
+
+    static uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0);
+    static uint32_t adler32(const uint8_t* data, size_t length, uint32_t adler = 1);
+    // Adler-32 of the concatenation of two buffers, from their sums and the second one's length
+    static uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondLength);
+    // Appends a length, type, payload and CRC chunk
+    static void appendChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* payload, size_t length);
+
+    static const int defaultStripeRows = 128;
+
+private:
+    int width;
+    int height;
+    int channels;
+    int bitDepth;
+    Level level;
+    int stripes;
+    FilterSource filters;
+
+    size_t rowBytes() const;
+    int bytesPerPixel() const;
+    // Filters and deflates rows [begin, end) into a complete IDAT chunk
+    void encodeStripe(const RowSource& rows, int begin, int end, bool first,
+                      std::vector<uint8_t>& chunk, uint32_t& adler, size_t& length) const;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef QUADTREE_CODEC_H
+#define QUADTREE_CODEC_H
+
+#include "QuadTreeNode.hpp"
+#include <vector>
+#include <cstdint>
+#include <string>
+
+// Compact binary form of a quadtree:
+//   "QTC" + version, width, height, node count (uint32 little endian),
+//   version 1 (quad splits only): one structure bit per node in pre-order (1 = split, 0 = leaf),
+//   version 2 (binary splits, palette, gradients or a non-RGB layout): a flags byte, then a 2-bit
+//     code per node (0 leaf, 1 quad, 2 cut across x, 3 cut across y) and, when flagged, a varint
+//     cut offset per binary node,
+//   then one color per leaf in pre-order, or, with a palette, the palette size minus one,
+//   the palette entries and a packed ceil(log2(size))-bit palette index per leaf; plane leaves
+//   add int16 gradients (x then y slopes, in 1/256 per pixel) per leaf at the end.
+// Colors, palette entries and gradients carry one sample per channel of the image layout
+// (see ChannelLayout); bits 3-4 of the flags byte hold the layout, 0 meaning RGB.
+class QuadTreeCodec {
+public:
+    // A non-empty palette stores leaves by their paletteIndex instead of their color
+    static std::vector<uint8_t> encode(const QuadTreeNode* root, int width, int height,
+                                       const std::vector<Pixel>& palette = std::vector<Pixel>(), int channels = 3);
+    static std::unique_ptr<QuadTreeNode> decode(const std::vector<uint8_t>& data, int& width, int& height);
+    static std::unique_ptr<QuadTreeNode> decode(const std::vector<uint8_t>& data, int& width, int& height, int& channels);
+    // Size of a tree with the given counts; binary trees also pay for their explicit cut offsets
+    static size_t encodedSize(int nodeCount, int leafCount, bool binarySplits = false, size_t offsetBytes = 0,
+                              int channels = 3);
+    static size_t encodedSize(const QuadTreeNode* root, const std::vector<Pixel>& palette = std::vector<Pixel>(),
+                              int channels = 3);
+    static size_t varintSize(uint32_t value);
+
+    static bool saveToFile(const std::vector<uint8_t>& data, const std::string& filepath);
+    static bool loadFromFile(const std::string& filepath, std::vector<uint8_t>& data);
+
+private:
+    static const int headerSize = 16;
+
+    enum NodeCode { LEAF = 0, QUAD = 1, CUT_X = 2, CUT_Y = 3 };
+    enum Flags { EXPLICIT_OFFSETS = 1, PALETTE = 2, GRADIENTS = 4, LAYOUT_SHIFT = 3, LAYOUT_MASK = 0x18 };
+
+    struct Reader {
+        const std::vector<uint8_t>& data;
+        int version;
+        int channels;
+        bool explicitOffsets;
+        size_t nodeCount;
+        size_t codeStart;
+        size_t nodeIndex;
+        size_t offsetPos;
+        size_t colorPos;
+        std::vector<Pixel> palette;
+        int indexBits;
+        size_t indexBit;
+        bool gradients;
+        size_t gradientPos;
+    };
+
+    static NodeCode codeOf(const QuadTreeNode* node, int& cut);
+    static void collect(const QuadTreeNode* node, std::vector<uint8_t>& codes, std::vector<uint32_t>& cuts,
+                        std::vector<const QuadTreeNode*>& leaves, bool& explicitOffsets);
+    static int indexBitsFor(size_t paletteSize);
+    static uint8_t layoutCode(int channels);
+    static int layoutChannels(uint8_t code);
+    static std::unique_ptr<QuadTreeNode> rebuild(int width, int height, Reader& reader);
+    static void readLeaf(QuadTreeNode& node, Reader& reader);
+    static uint32_t readVarint(Reader& reader);
+    static void writePaletteIndices(std::vector<uint8_t>& out, const std::vector<const QuadTreeNode*>& leaves,
+                                    const std::vector<Pixel>& palette, int channels);
+    static void writeInt16(std::vector<uint8_t>& out, int16_t value);
+    static int16_t readInt16(const std::vector<uint8_t>& data, size_t offset);
+    static void writeUint32(std::vector<uint8_t>& out, uint32_t value);
+    static uint32_t readUint32(const std::vector<uint8_t>& data, size_t offset);
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef QUADTREE_JPEG_ENCODER_H
+#define QUADTREE_JPEG_ENCODER_H
+
+#include "QuadTreeNode.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Baseline JPEG writer fed from a compressed tree. An 8x8 block whose pixels all lie inside one
+// flat leaf has a single DC coefficient, which is coded straight from the leaf color without a
+// transform; only blocks crossing leaf edges (or inside gradient leaves) are generated and run
+// through the DCT. Uses the same color conversion, float DCT, tables and 4:2:0 subsampling at
+// quality 90 and below as stb_image_write, so the output matches saveImage on the reconstructed
+// image byte for byte.
+class QuadTreeJpegEncoder {
+public:
+    explicit QuadTreeJpegEncoder(const QuadTreeNode* root, int quality = 90);
+
+    std::vector<uint8_t> encode() const;
+    bool write(const std::string& filepath) const;
+    // Luma and chroma blocks of the last encode, and how many of them were coded as DC only
+    size_t getBlockCount() const;
+    size_t getFlatBlockCount() const;
+
+private:
+    const QuadTreeNode* root;
+    int quality;
+    mutable size_t blockCount;
+    mutable size_t flatBlockCount;
+
+    // Flat leaf holding the image pixels of block column c for every column, or nullptr, for the
+    // pixel rows [top, bottom); blocks past the right edge repeat the last column as JPEG pads
+    static void findFlatBlocks(const QuadTreeNode* node, int top, int bottom, int width,
+                               std::vector<const QuadTreeNode*>& flat);
+    // Fills rows [top, bottom) of the image into strip, one row of width pixels after another
+    static void fillStrip(const QuadTreeNode* node, int top, int bottom, int width, std::vector<Pixel>& strip);
+};
+
+#endif
@@ -3,42 +3,151 @@
 
 #include "ImagePixel.hpp"
 #include "ErrorCalculator.hpp"
+#include "StatisticsPyramid.hpp"
+#include "MomentImage.hpp"
 #include <memory>
 #include <queue>
+#include <vector>
+#include <cmath>
+
+struct BlockRect {
+    int x, y;
+    int width, height;
+};
 
 struct QuadTreeNode {
     int x, y;
     int width, height;
     Pixel averageColor;
     bool isLeaf;
+    double error;          // block error under the compressor's method
+    double squaredError;   // sum of squared differences to averageColor over all channels
+    int paletteIndex;      // entry of the compressor palette used by a leaf, -1 without palette
+    bool hasGradient;      // plane leaf model: color varies linearly across the block
+    float gradientX[4];    // per-pixel slope of each component (r, g, b, a) around the block center
+    float gradientY[4];
+    // Quad splits fill all four children; binary splits fill children[0] and children[1]
     std::unique_ptr<QuadTreeNode> children[4];
     
     QuadTreeNode(int x, int y, int w, int h) 
-        : x(x), y(y), width(w), height(h), isLeaf(false) {
+        : x(x), y(y), width(w), height(h), isLeaf(false), error(0.0), squaredError(0.0), paletteIndex(-1), hasGradient(false) {
         for (int i = 0; i < 4; i++) children[i] = nullptr;
+        for (int c = 0; c < 4; c++) gradientX[c] = gradientY[c] = 0.0f;
+    }
+    
+    // Frees the subtree with an explicit stack instead of a chain of nested unique_ptr destructors:
+    // children are released before their node is deleted, so every delete finds a childless node
+    ~QuadTreeNode() {
+        if (!children[0] && !children[1] && !children[2] && !children[3]) return;
+        std::vector<QuadTreeNode*> pending;
+        pending.reserve(64);
+        for (int i = 3; i >= 0; i--) {
+            if (children[i]) pending.push_back(children[i].release());
+        }
+        while (!pending.empty()) {
+            QuadTreeNode* node = pending.back();
+            pending.pop_back();
+            for (int i = 3; i >= 0; i--) {
+                if (node->children[i]) pending.push_back(node->children[i].release());
+            }
+            delete node;
+        }
+    }
+    
+    // Color of pixel (px, py) inside the block under the node's leaf model
+    Pixel colorAt(int px, int py) const {
+        if (!hasGradient) return averageColor;
+        float dx = px - (x + (width - 1) * 0.5f);
+        float dy = py - (y + (height - 1) * 0.5f);
+        uint8_t values[4];
+        for (int c = 0; c < 4; c++) {
+            float v = std::floor(averageColor[c] + 0.5f + gradientX[c] * dx + gradientY[c] * dy);
+            values[c] = static_cast<uint8_t>(v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v));
+        }
+        return Pixel(values[0], values[1], values[2], values[3]);
     }
 };
 
 class QuadTreeCompressor {
 public:
+    enum SplitPolicy {
+        QUAD_SPLIT = 1,         // halve both dimensions (classic quadtree)
+        LONGER_AXIS_SPLIT = 2,  // halve only the longer dimension (KD-style binary split)
+        BEST_SPLIT = 3          // binary split at the candidate cut with the lowest squared error
+    };
+    
+    enum LeafModel {
+        FLAT_MODEL = 1,   // one average color per leaf
+        PLANE_MODEL = 2   // average color plus a least-squares gradient per channel
+    };
+    
+    enum BuildStrategy {
+        PYRAMID_BUILD = 1,  // block statistics from a shared StatisticsPyramid
+        FUSED_BUILD = 2,    // direct scans with the metric inlined (MetricTreeBuilder), quad splits and flat leaves only
+        BOUNDED_BUILD = 3,  // fused, with scans that stop once the block is known to split (moment and range metrics)
+        LEVEL_BUILD = 4     // pyramid statistics, one parallel sweep over each tree level's blocks
+    };
+    
     QuadTreeCompressor(ImagePixel& image, ErrorCalculator::ErrorMethod method, double threshold, int minBlockSize);
+    // Reuses a pyramid built by the caller, e.g. when sweeping several methods over one image
+    QuadTreeCompressor(ImagePixel& image, const StatisticsPyramid& pyramid, ErrorCalculator::ErrorMethod method, double threshold, int minBlockSize);
+    void setSplitPolicy(SplitPolicy policy);
+    void setLeafModel(LeafModel model);
+    void setBuildStrategy(BuildStrategy strategy);
+    // Fused and bounded builds only: the root's quadrants are built by pinned workers from
+    // thread-local copies of their pixels (see MetricTreeBuilder)
+    void setPartitioned(bool partitioned);
     void compress();
-    void reconstruct(ImagePixel& outputImage);
+    // Builds the tree with a compile-time metric (see BlockMetrics.hpp), ignoring the error method;
+    // bounded enables early-exit scans for metrics with a lowerBound. Defined in MetricTreeBuilder.hpp
+    template <typename Metric> void compressWith(bool bounded = false);
+    // Quantizes the leaf colors of the compressed tree to a palette of at most paletteSize (2-256)
+    // entries; throws std::invalid_argument for other sizes
+    void applyPalette(int paletteSize);
+    const std::vector<Pixel>& getPalette() const;
+    void reconstruct(ImagePixel& outputImage) const;
     int getTreeDepth() const;
     int getNodeCount() const;
+    const QuadTreeNode* getRoot() const;
+    static bool canSplit(int width, int height, int minBlockSize);
+    // True when every child of the node is at least minBlockSize on both sides
+    static bool childrenFit(const QuadTreeNode* node, int minBlockSize);
     
 private:
     ImagePixel& image;
     ErrorCalculator::ErrorMethod method;
     double threshold;
     int minBlockSize;
+    SplitPolicy splitPolicy;
+    LeafModel leafModel;
+    BuildStrategy buildStrategy;
+    bool partitioned;
+    std::unique_ptr<MomentImage> moments;
+    std::unique_ptr<StatisticsPyramid> ownedPyramid;
+    const StatisticsPyramid* pyramid;
+    BlockStatistics blockStats;
+    BlockStatistics candidateStats;
     std::unique_ptr<QuadTreeNode> root;
+    std::vector<Pixel> palette;
     int treeDepth;
     int nodeCount;
     
+    // Builds the subtree of a block without recursion, so degenerate trees cannot exhaust the stack
     std::unique_ptr<QuadTreeNode> buildQuadTree(int x, int y, int width, int height, int currentDepth);
-    void reconstructImage(QuadTreeNode* node, std::vector<std::vector<Pixel>>& matrix);
-    void getBlock(const ImagePixel& img, int x, int y, int width, int height, std::vector<std::vector<Pixel>>& block);
+    // Breadth first: the frontier of one level is evaluated by all workers, then the blocks that
+    // split are compacted into the next level's frontier
+    std::unique_ptr<QuadTreeNode> buildLevels();
+    // Error, color and leaf model of a node from its block's statistics; stats is scratch space,
+    // so workers can evaluate nodes side by side with their own
+    void evaluateNode(QuadTreeNode& node, BlockStatistics& stats) const;
+    int splitBlock(const BlockRect& block, BlockRect children[4], BlockStatistics& stats) const;
+    int splitBest(const BlockRect& block, BlockRect children[4], BlockStatistics& stats) const;
+    double squaredErrorOf(const BlockRect& block, BlockStatistics& stats) const;
+    static double squaredErrorAgainst(const BlockStatistics& stats, const Pixel& color);
+    static double squaredErrorAgainst(const PlaneFit& fit, const QuadTreeNode& node);
+    static float quantizeGradient(double gradient);
+    static void collectLeaves(QuadTreeNode* node, std::vector<QuadTreeNode*>& leaves);
+    void reconstructImage(QuadTreeNode* node, ImagePixel& outputImage) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef QUADTREE_PNG_ENCODER_H
+#define QUADTREE_PNG_ENCODER_H
+
+#include "QuadTreeNode.hpp"
+#include "PngWriter.hpp"
+
+// Writes a compressed tree as PNG straight from its leaves, without reconstructing the image.
+// Scanlines are filled from the leaves crossing them, and the filters follow the tree: a row with
+// no leaf edge and no gradient leaf on it repeats the row above and goes out as an all-zero Up row
+// without being generated. Any other row uses Up as well at the stored and fast levels, which
+// zeroes every pixel of the row outside gradient leaves and the leaves starting on it, and the
+// adaptive choice at the default level. Both shapes deflate to long runs (see PngWriter).
+class QuadTreePngEncoder {
+public:
+    explicit QuadTreePngEncoder(const QuadTreeNode* root, int channels = 3);
+
+    void setLevel(PngWriter::Level level);
+    void setStripes(int stripes);
+
+    std::vector<uint8_t> encode() const;
+    bool write(const std::string& filepath) const;
+
+private:
+    const QuadTreeNode* root;
+    int channels;
+    PngWriter::Level level;
+    int stripes;
+
+    // Writer with the tree's filters; rowChanges must outlive it
+    PngWriter makeWriter(std::vector<uint8_t>& rowChanges) const;
+    PngWriter::RowSource rowSource() const;
+    // Flags the rows that differ from the row above: leaf tops, and every row of a gradient leaf
+    static void markRowChanges(const QuadTreeNode* node, int top, std::vector<uint8_t>& rowChanges);
+    template <int C>
+    static void fillRow(const QuadTreeNode* node, int y, int left, uint8_t* row);
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef QUADTREE_QUERY_H
+#define QUADTREE_QUERY_H
+
+#include "QuadTreeNode.hpp"
+#include <vector>
+
+// Read-only queries against a compressed tree, without reconstructing the image. Every query
+// descends only into nodes that overlap it, so cost follows the queried area and the leaves in it.
+// Works with every split policy and leaf model.
+class QuadTreeQuery {
+public:
+    explicit QuadTreeQuery(const QuadTreeNode* root, int channels = 3);
+
+    // Leaf covering pixel (x, y), nullptr outside the tree
+    const QuadTreeNode* leafAt(int x, int y) const;
+    // Color of pixel (x, y) under its leaf's model; throws std::out_of_range outside the tree
+    Pixel colorAt(int x, int y) const;
+    // Leaves intersecting rect, in tree order
+    void leavesInRect(const BlockRect& rect, std::vector<const QuadTreeNode*>& leaves) const;
+    // Renders viewport (clipped to the tree) at 1/zoom scale with QuadTreeRenderer, rounding the
+    // output size up
+    void renderViewport(const BlockRect& viewport, int zoom, ImagePixel& outputImage) const;
+
+private:
+    const QuadTreeNode* root;
+    int channels;
+
+    static bool intersects(const QuadTreeNode* node, const BlockRect& rect);
+    static bool contains(const QuadTreeNode* node, int x, int y);
+    void collectLeaves(const QuadTreeNode* node, const BlockRect& rect, std::vector<const QuadTreeNode*>& leaves) const;
+};
+
+#endif
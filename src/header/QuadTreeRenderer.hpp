@@ -0,0 +1,34 @@
+#ifndef QUADTREE_RENDERER_H
+#define QUADTREE_RENDERER_H
+
+#include "QuadTreeNode.hpp"
+
+// Draws a region of a compressed tree at any output size. Output pixel (i, j) takes the color at
+// the source point under its center; node rectangles are scaled onto output pixel ranges directly.
+// A node smaller than one output pixel in both directions is drawn with its own color instead of
+// being descended, so the cost follows the output size rather than the tree size.
+class QuadTreeRenderer {
+public:
+    explicit QuadTreeRenderer(const QuadTreeNode* root, int channels = 3);
+
+    void render(int outputWidth, int outputHeight, ImagePixel& outputImage) const;
+    // region is clipped to the tree; throws std::invalid_argument when nothing is left
+    void render(const BlockRect& region, int outputWidth, int outputHeight, ImagePixel& outputImage) const;
+
+private:
+    // Output range [first, last) of one axis mapped onto source pixels [origin, origin + length)
+    struct Axis {
+        int origin, length, size;
+        // First output index whose center lies at or beyond source coordinate edge
+        int firstAt(int edge) const;
+        int sourceOf(int index) const;
+    };
+
+    const QuadTreeNode* root;
+    int channels;
+
+    void renderNode(const QuadTreeNode* node, const Axis& axisX, const Axis& axisY,
+                    ImagePixel& outputImage) const;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef QUADTREE_SVG_WRITER_H
+#define QUADTREE_SVG_WRITER_H
+
+#include "QuadTreeNode.hpp"
+#include <ostream>
+#include <string>
+
+// Writes the leaves of a compressed tree as SVG rectangles, streamed while the tree is walked.
+// A subtree whose leaves all share one flat color becomes a single rect; so do pairs of sibling
+// subtrees that line up (the two halves of a node), and consecutive rects of one color that share
+// a full edge. Gradient leaves become rects filled with a linear gradient along their steepest
+// slope. Alpha goes to fill-opacity.
+class QuadTreeSvgWriter {
+public:
+    explicit QuadTreeSvgWriter(const QuadTreeNode* root, int channels = 3);
+
+    void write(std::ostream& out) const;
+    bool saveToFile(const std::string& filepath) const;
+    // Shapes written by the last write, after merging
+    size_t getShapeCount() const;
+
+private:
+    struct Rect {
+        int x, y, width, height;
+        Pixel color;
+    };
+
+    // Output state of one write: the rect waiting to be extended by the next one
+    struct Stream {
+        std::ostream& out;
+        bool pending;
+        Rect rect;
+        size_t shapes;
+        size_t gradients;
+    };
+
+    const QuadTreeNode* root;
+    int channels;
+    mutable size_t shapeCount;
+
+    // Emits the subtree unless all of it is one flat color, which is then returned in color for
+    // the parent to merge
+    bool visit(const QuadTreeNode* node, Stream& stream, Pixel& color) const;
+    void emitRect(const Rect& rect, Stream& stream) const;
+    void flush(Stream& stream) const;
+    void writeGradientLeaf(const QuadTreeNode* node, Stream& stream) const;
+    // Writes colorAttribute="#rrggbb", plus opacityAttribute for translucent colors of layouts with alpha
+    void writePaint(const Pixel& color, const char* colorAttribute, const char* opacityAttribute,
+                    std::ostream& out) const;
+};
+
+#endif
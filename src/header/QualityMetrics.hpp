@@ -0,0 +1,39 @@
+#ifndef QUALITY_METRICS_H
+#define QUALITY_METRICS_H
+
+#include "ImagePixel.hpp"
+#include "QuadTreeNode.hpp"
+#include <cstdint>
+
+struct QualityReport {
+    double mse;
+    double psnr;
+    double ssim;
+};
+
+// Quality of a reconstruction against its original image, over the channels of the original's
+// layout. Rows are split across threads and accumulated with integer sums, so the result does
+// not depend on the thread count.
+class QualityMetrics {
+public:
+    // Throws std::invalid_argument unless both images have the same size and channel count
+    static QualityReport compare(const ImagePixel& original, const ImagePixel& reconstructed);
+    // MSE straight from the leaves' squared errors, without rendering the image
+    static double analyticMSE(const QuadTreeNode* root, int width, int height, int channels = 3);
+    static double psnrFromMSE(double mse);
+    static size_t encodedSize(const QuadTreeNode* root, const std::vector<Pixel>& palette = std::vector<Pixel>(),
+                              int channels = 3);
+
+private:
+    // Per channel: sum x, sum y, sum x^2, sum y^2, sum xy, sum (x - y)^2
+    struct ChannelSums {
+        uint64_t sumX, sumY, sumXX, sumYY, sumXY, sumDiff;
+    };
+
+    template <int C>
+    static void accumulateRows(const ImagePixel& original, const ImagePixel& reconstructed,
+                               int rowBegin, int rowEnd, ChannelSums sums[C]);
+    static double leafSquaredError(const QuadTreeNode* node);
+};
+
+#endif
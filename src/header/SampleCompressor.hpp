@@ -0,0 +1,62 @@
+#ifndef SAMPLE_COMPRESSOR_H
+#define SAMPLE_COMPRESSOR_H
+
+#include "SampleImage.hpp"
+#include "ErrorCalculator.hpp"
+#include <memory>
+
+template <typename T>
+struct SampleNode {
+    int x, y;
+    int width, height;
+    bool isLeaf;
+    double error;
+    T value[ChannelLayout::maxChannels]; // block representative per channel, at full precision
+    std::unique_ptr<SampleNode> children[4];
+
+    SampleNode(int x, int y, int w, int h) : x(x), y(y), width(w), height(h), isLeaf(false), error(0.0), value() {}
+};
+
+// Quadtree compressor for 16-bit and float images that never narrows the samples.
+// Blocks are scanned directly with the sample type's own accumulators (exact integer moments,
+// compensated float moments) and the errors are normalized against its full scale, so a
+// threshold means the same as for 8-bit images. Instantiated for uint16_t and float.
+template <typename T>
+class SampleCompressor {
+public:
+    SampleCompressor(const SampleImage<T>& image, ErrorCalculator::ErrorMethod method, double threshold, int minBlockSize);
+    void compress();
+    void reconstruct(SampleImage<T>& outputImage) const;
+    int getTreeDepth() const;
+    int getNodeCount() const;
+    const SampleNode<T>* getRoot() const;
+
+    // Mean squared error in sample units and PSNR against the sample type's full scale
+    static double meanSquaredError(const SampleImage<T>& original, const SampleImage<T>& reconstructed);
+    static double psnrFromMSE(double mse);
+
+private:
+    using Traits = SampleTraits<T>;
+    using Moments = typename Traits::Moments;
+
+    const SampleImage<T>& image;
+    ErrorCalculator::ErrorMethod method;
+    double threshold;
+    int minBlockSize;
+    std::unique_ptr<SampleNode<T>> root;
+    int treeDepth;
+    int nodeCount;
+    // Entropy histograms, channels interleaved per bin, filled during the block's single scan and
+    // cleared through the lists of bins the block touched
+    std::vector<uint32_t> histogram;
+    std::vector<int> touchedBins[ChannelLayout::maxChannels];
+
+    std::unique_ptr<SampleNode<T>> buildQuadTree(int x, int y, int width, int height, int currentDepth);
+    double evaluateBlock(const SampleNode<T>& node, T* values);
+    bool usesHistogram() const;
+    // Entropy of one channel's histogram, which it clears
+    double channelEntropy(int channel, uint64_t count);
+    void reconstructNode(const SampleNode<T>* node, SampleImage<T>& outputImage) const;
+};
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef SAMPLE_IMAGE_H
+#define SAMPLE_IMAGE_H
+
+#include "ImagePixel.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Forward declarations from stb
+extern "C" {
+    unsigned short* stbi_load_16(char const* filename, int* x, int* y, int* comp, int req_comp);
+    float* stbi_loadf(char const* filename, int* x, int* y, int* comp, int req_comp);
+    void stbi_ldr_to_hdr_gamma(float gamma);
+    int stbi_write_hdr(char const* filename, int w, int h, int comp, const float* data);
+}
+
+// Exact running moments for integer samples. The square sums of 16-bit samples fit 64 bits
+// for up to 2^32 samples; the variance numerator is formed in 128 bits so it stays exact.
+struct IntegerMoments {
+    uint64_t sum = 0;
+    uint64_t sumSquares = 0;
+
+    void add(uint32_t value) {
+        sum += value;
+        sumSquares += static_cast<uint64_t>(value) * value;
+    }
+    double mean(uint64_t count) const { return static_cast<double>(sum) / count; }
+    double variance(uint64_t count) const {
+        unsigned __int128 scaled = static_cast<unsigned __int128>(sumSquares) * count;
+        unsigned __int128 squared = static_cast<unsigned __int128>(sum) * sum;
+        double numerator = scaled > squared ? static_cast<double>(scaled - squared) : 0.0;
+        return numerator / (static_cast<double>(count) * count);
+    }
+};
+
+// Neumaier-compensated running sum
+struct CompensatedSum {
+    double total = 0, compensation = 0;
+
+    void add(double value) {
+        double next = total + value;
+        compensation += std::fabs(total) >= std::fabs(value) ? (total - next) + value : (value - next) + total;
+        total = next;
+    }
+    double value() const { return total + compensation; }
+};
+
+// Compensated moments for floating point samples, taken around the first sample: the
+// compensation keeps each sum accurate, and the shift keeps sumSquares / n - mean^2 from
+// cancelling away the variance of blocks with a large offset and a small spread
+struct CompensatedMoments {
+    bool started = false;
+    double shift = 0;
+    CompensatedSum sum, sumSquares;
+
+    void add(double value) {
+        if (!started) {
+            shift = value;
+            started = true;
+        }
+        double offset = value - shift;
+        sum.add(offset);
+        sumSquares.add(offset * offset);
+    }
+    double mean(uint64_t count) const { return shift + sum.value() / count; }
+    double variance(uint64_t count) const {
+        double offsetMean = sum.value() / count;
+        return std::max(sumSquares.value() / count - offsetMean * offsetMean, 0.0);
+    }
+};
+
+// Per sample type: accumulator, full-scale value and histogram binning. The error
+// normalization constants (see SampleScale) are all derived from these.
+template <typename T> struct SampleTraits;
+
+template <> struct SampleTraits<uint16_t> {
+    using Moments = IntegerMoments;
+    static constexpr double maxValue = 65535.0;
+    static constexpr int histogramBins = 65536;
+    static int bin(uint16_t value) { return value; }
+    static uint16_t fromMean(double value) { return static_cast<uint16_t>(std::min(65535.0, std::round(value))); }
+};
+
+// Float samples are nominally in [0, 1]; HDR values above 1 are kept, and only the
+// histogram clamps them into its top bin
+template <> struct SampleTraits<float> {
+    using Moments = CompensatedMoments;
+    static constexpr double maxValue = 1.0;
+    static constexpr int histogramBins = 65536;
+    static int bin(float value) {
+        return static_cast<int>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+    }
+    static float fromMean(double value) { return static_cast<float>(value); }
+};
+
+// Error normalization of the 8-bit metrics, rescaled to the sample type's full scale
+template <typename T>
+struct SampleScale {
+    static double maxVariance() { return (SampleTraits<T>::maxValue / 2) * (SampleTraits<T>::maxValue / 2); }
+    static double maxMAD() { return SampleTraits<T>::maxValue / 2; }
+    static double maxDiff() { return SampleTraits<T>::maxValue; }
+    static double maxEntropy() { return std::log2(static_cast<double>(SampleTraits<T>::histogramBins)); }
+};
+
+// Interleaved image of 1-4 channels (see ChannelLayout) at the sample type's full precision:
+// uint16_t (loaded with stbi_load_16) or float (loaded with stbi_loadf). 8-bit images are
+// ImagePixels
+template <typename T>
+class SampleImage {
+public:
+    SampleImage() : width(0), height(0), channels(0) {}
+
+    bool loadImage(const std::string& filepath);
+    // 16-bit samples are written as 16-bit PNG, or narrowed for JPEG; float samples only as
+    // Radiance HDR, and any other extension fails rather than losing their range
+    bool saveImage(const std::string& filepath) const;
+
+    void create(int newWidth, int newHeight, int newChannels) {
+        width = newWidth;
+        height = newHeight;
+        channels = newChannels;
+        samples.assign(static_cast<size_t>(width) * height * channels, T());
+    }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getChannels() const { return channels; }
+    const T* row(int y) const { return &samples[static_cast<size_t>(y) * width * channels]; }
+    T* row(int y) { return &samples[static_cast<size_t>(y) * width * channels]; }
+    const std::vector<T>& getSamples() const { return samples; }
+
+private:
+    std::vector<T> samples;
+    int width;
+    int height;
+    int channels;
+};
+
+template <> bool SampleImage<uint16_t>::loadImage(const std::string& filepath);
+template <> bool SampleImage<float>::loadImage(const std::string& filepath);
+template <> bool SampleImage<uint16_t>::saveImage(const std::string& filepath) const;
+template <> bool SampleImage<float>::saveImage(const std::string& filepath) const;
+
+#endif
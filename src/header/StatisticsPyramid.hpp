@@ -0,0 +1,85 @@
+#ifndef STATISTICS_PYRAMID_H
+#define STATISTICS_PYRAMID_H
+
+#include <vector>
+#include <cstdint>
+#include "ImagePixel.hpp"
+
+// Sufficient statistics of a rectangular block, per channel of the image layout
+struct BlockStatistics {
+    int channels;  // samples per pixel, see ChannelLayout; only the first channels entries are used
+    uint64_t count;
+    uint64_t sum[ChannelLayout::maxChannels];
+    uint64_t sumSquares[ChannelLayout::maxChannels];
+    uint8_t minValue[ChannelLayout::maxChannels];
+    uint8_t maxValue[ChannelLayout::maxChannels];
+    // 256 bins per channel, only filled when requested in the query
+    std::vector<uint32_t> histogram;
+
+    BlockStatistics() { reset(3, false); }
+    void reset(int channels, bool withHistogram);
+    bool hasHistogram() const { return !histogram.empty(); }
+    void addPixel(const Pixel& p);
+
+    template <int C>
+    void addSamples(const uint8_t* samples) {
+        count++;
+        for (int c = 0; c < C; c++) {
+            sum[c] += samples[c];
+            sumSquares[c] += static_cast<uint64_t>(samples[c]) * samples[c];
+            if (samples[c] < minValue[c]) minValue[c] = samples[c];
+            if (samples[c] > maxValue[c]) maxValue[c] = samples[c];
+        }
+        if (!histogram.empty()) {
+            for (int c = 0; c < C; c++) histogram[c * 256 + samples[c]]++;
+        }
+    }
+};
+
+// Per-image statistics over power-of-two cells, built once and shared by every error method.
+// Level L holds cells of 2^L x 2^L pixels; arbitrary rectangles are answered by merging the
+// largest cells lying inside them and scanning only the leftover border pixels.
+class StatisticsPyramid {
+public:
+    StatisticsPyramid(const ImagePixel& image, bool withHistograms = true);
+
+    void query(int x, int y, int width, int height, BlockStatistics& stats, bool withHistogram) const;
+    bool hasHistograms() const;
+    int getChannels() const;
+    int getLevelCount() const;
+    const ImagePixel& getImage() const;
+
+private:
+    // Cell statistics with channels entries per cell, so gray images store and merge a third
+    struct Level {
+        int gridWidth, gridHeight;
+        std::vector<uint32_t> counts;
+        std::vector<uint64_t> sums;
+        std::vector<uint64_t> sumSquares;
+        std::vector<uint8_t> minValues;
+        std::vector<uint8_t> maxValues;
+        std::vector<uint32_t> histograms; // 256 bins per channel and cell, empty below histogramLevel
+
+        void allocate(int width, int height, int channels);
+    };
+
+    // Finest stored level (4x4 cells) and finest level carrying histograms (32x32 cells)
+    static const int baseLevel = 2;
+    static const int histogramLevel = 5;
+
+    const ImagePixel& image;
+    bool withHistograms;
+    int channels;
+    int topLevel;
+    std::vector<Level> levels; // levels[i] holds level baseLevel + i
+
+    // Kernels are instantiated per channel count C (see ChannelLayout::dispatch)
+    template <int C> void buildBaseLevel();
+    template <int C> void buildLevel(int level);
+    template <int C> void queryCell(int level, int cx, int cy, int x0, int y0, int x1, int y1,
+                                    BlockStatistics& stats, bool withHistogram) const;
+    template <int C> void scanPixels(int x0, int y0, int x1, int y1, BlockStatistics& stats) const;
+    template <int C> void scanHistogram(int x0, int y0, int x1, int y1, BlockStatistics& stats) const;
+};
+
+#endif
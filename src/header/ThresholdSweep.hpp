@@ -0,0 +1,59 @@
+#ifndef THRESHOLD_SWEEP_H
+#define THRESHOLD_SWEEP_H
+
+#include "QuadTreeNode.hpp"
+#include <vector>
+#include <ostream>
+
+// Result of cutting the refined tree at one (threshold, minBlockSize) pair
+struct SweepResult {
+    double threshold;
+    int minBlockSize;
+    int nodeCount;
+    int leafCount;
+    int treeDepth;
+    double mse;
+    double psnr;
+    size_t encodedBytes;
+};
+
+// Builds one fully refined tree annotated with per-node errors, then evaluates a whole list of
+// thresholds in a single traversal per block size. A node survives a threshold t when every
+// ancestor has error > t, and it is a leaf when its own error <= t or it cannot split further.
+// Larger block sizes re-cut the same tree; with BEST_SPLIT the cut positions chosen for the
+// smallest block size are kept, so those rows approximate a direct run.
+class ThresholdSweep {
+public:
+    ThresholdSweep(ImagePixel& image, ErrorCalculator::ErrorMethod method, int minBlockSize,
+                   QuadTreeCompressor::SplitPolicy policy = QuadTreeCompressor::QUAD_SPLIT);
+
+    // Block sizes smaller than the one given to the constructor are clamped up to it
+    std::vector<SweepResult> run(const std::vector<double>& thresholds, const std::vector<int>& blockSizes);
+    void render(double threshold, int minBlockSize, ImagePixel& outputImage) const;
+    static void printTable(const std::vector<SweepResult>& results, std::ostream& out);
+
+private:
+    struct Accumulator {
+        std::vector<long long> nodeDiff;
+        std::vector<long long> leafDiff;
+        std::vector<double> squaredErrorDiff;
+        // Binary nodes, those cut off the middle, and the varint bytes of all their cuts: the
+        // encoder writes every cut once any of them is off the middle
+        std::vector<long long> binaryDiff;
+        std::vector<long long> offMiddleDiff;
+        std::vector<long long> cutBytesDiff;
+        std::vector<int> depthAtPrefix;
+    };
+
+    ImagePixel& image;
+    int baseBlockSize;
+    QuadTreeCompressor::SplitPolicy policy;
+    QuadTreeCompressor compressor;
+
+    void sweepNode(const QuadTreeNode* node, int depth, double pathMin, int minBlockSize,
+                   const std::vector<double>& thresholds, Accumulator& acc) const;
+    void renderNode(const QuadTreeNode* node, double threshold, int minBlockSize,
+                    ImagePixel& outputImage) const;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "../header/ErrorCalculator.hpp"
+#include "../header/MetricRegistry.hpp"
 
 double ErrorCalculator::calculateError(ErrorMethod method, 
                            const std::vector<std::vector<Pixel>>& block,
@@ -8,148 +9,129 @@ double ErrorCalculator::calculateError(ErrorMethod method,
         case MEAN_ABSOLUTE_DEVIATION: return calculateMAD(block, rValue, gValue, bValue);
         case MAX_PIXEL_DIFFERENCE: return calculateMaxDiff(block, rValue, gValue, bValue);
         case ENTROPY: return calculateEntropy(block, rValue, gValue, bValue);
-        default: throw std::invalid_argument("Invalid error method");
+        case SSIM: return calculateSSIM(block, rValue, gValue, bValue);
+        case PLANE_RESIDUAL: return calculatePlaneFit(block, rValue, gValue, bValue);
+        default: break;
     }
+    
+    // Registered metrics read the block's statistics, gathered in one pass for every component
+    BlockStatistics stats;
+    stats.reset(3, requiresHistogram(method));
+    for (const auto& row : block) {
+        for (const Pixel& p : row) stats.addPixel(p);
+    }
+    double values[ChannelLayout::maxChannels];
+    double error = MetricRegistry::evaluate(method, stats, values);
+    rValue = values[0];
+    gValue = values[1];
+    bValue = values[2];
+    return error;
 }
 
-double ErrorCalculator::calculateVariance(const std::vector<std::vector<Pixel>>& block,
-                              double& rMean, double& gMean, double& bMean) {
-    calculateMeans(block, rMean, gMean, bMean);
-    
-    double maxVariance = 16256.25;
-    double rVar = 0, gVar = 0, bVar = 0;
-    int count = 0;
-    
+double ErrorCalculator::calculateError(ErrorMethod method, const BlockStatistics& stats, double* values) {
+    return MetricRegistry::evaluate(method, stats, values);
+}
+
+// One scan with the metric's accumulator (see BlockMetrics.hpp): moments, histograms and ranges
+// are gathered together, so every pixel is read once and the mean is applied in finalize
+template <typename Metric>
+double ErrorCalculator::evaluateBlock(const std::vector<std::vector<Pixel>>& block,
+                                      double& rValue, double& gValue, double& bValue) {
+    typename Metric::State state;
+    uint8_t samples[3];
     for (const auto& row : block) {
         for (const Pixel& p : row) {
-            rVar += (p.r - rMean) * (p.r - rMean);
-            gVar += (p.g - gMean) * (p.g - gMean);
-            bVar += (p.b - bMean) * (p.b - bMean);
-            count++;
+            ChannelLayout::extract<3>(p, samples);
+            Metric::template accumulate<3>(state, samples);
         }
     }
-    
-    rVar /= count;
-    gVar /= count;
-    bVar /= count;
-    
-    return (rVar + gVar + bVar) / (3.0 * maxVariance);
+    double values[ChannelLayout::maxChannels];
+    double error = Metric::finalize(state, 3, values);
+    rValue = values[0];
+    gValue = values[1];
+    bValue = values[2];
+    return error;
+}
+
+bool ErrorCalculator::requiresHistogram(ErrorMethod method) {
+    return (MetricRegistry::statisticsOf(method) & HISTOGRAM_STATISTICS) != 0;
+}
+
+double ErrorCalculator::calculateVariance(const std::vector<std::vector<Pixel>>& block,
+                              double& rMean, double& gMean, double& bMean) {
+    return evaluateBlock<VarianceMetric>(block, rMean, gMean, bMean);
 }
 
 double ErrorCalculator::calculateMAD(const std::vector<std::vector<Pixel>>& block,
                          double& rMean, double& gMean, double& bMean) {
-    calculateMeans(block, rMean, gMean, bMean);
-    
-    double maxMAD = 127.5;
-    double rMad = 0, gMad = 0, bMad = 0;
-    int count = 0;
-    
-    for (const auto& row : block) {
-        for (const Pixel& p : row) {
-            rMad += std::abs(p.r - rMean);
-            gMad += std::abs(p.g - gMean);
-            bMad += std::abs(p.b - bMean);
-            count++;
-        }
-    }
-    
-    rMad /= count;
-    gMad /= count;
-    bMad /= count;
-    
-    return (rMad + gMad + bMad) / (3.0 * maxMAD);
+    return evaluateBlock<MeanAbsoluteDeviationMetric>(block, rMean, gMean, bMean);
 }
 
 double ErrorCalculator::calculateMaxDiff(const std::vector<std::vector<Pixel>>& block,
                              double& rMean, double& gMean, double& bMean) {
-    const double diffMax = 255.0;
-    if (block.empty() || block[0].empty()) return 0.0;
-    
-    uint8_t rMin = block[0][0].r, rMax = block[0][0].r;
-    uint8_t gMin = block[0][0].g, gMax = block[0][0].g;
-    uint8_t bMin = block[0][0].b, bMax = block[0][0].b;
-    
-    for (const auto& row : block) {
-        for (const Pixel& p : row) {
-            rMin = std::min(rMin, p.r);
-            rMax = std::max(rMax, p.r);
-            gMin = std::min(gMin, p.g);
-            gMax = std::max(gMax, p.g);
-            bMin = std::min(bMin, p.b);
-            bMax = std::max(bMax, p.b);
-        }
-    }
-    
-    rMean = (rMax + rMin) / 2.0;
-    gMean = (gMax + gMin) / 2.0;
-    bMean = (bMax + bMin) / 2.0;
-    
-    double rDiff = rMax - rMin;
-    double gDiff = gMax - gMin;
-    double bDiff = bMax - bMin;
-    
-    return (rDiff + gDiff + bDiff) / (3.0 * diffMax);
+    return evaluateBlock<MaxDifferenceMetric>(block, rMean, gMean, bMean);
 }
 
 double ErrorCalculator::calculateEntropy(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean) {
-    calculateMeans(block, rMean, gMean, bMean);
-    
-    std::map<uint8_t, int> rHist, gHist, bHist;
-    calculateHistograms(block, rHist, gHist, bHist);
-    
-    double maxEntropy = 8.0;
-    int totalPixels = block.size() * block[0].size();
-    double rEntropy = 0, gEntropy = 0, bEntropy = 0;
-    
-    for (const auto& pair : rHist) {
-        double prob = pair.second / static_cast<double>(totalPixels);
-        rEntropy -= prob * log2(prob);
-    }
-    
-    for (const auto& pair : gHist) {
-        double prob = pair.second / static_cast<double>(totalPixels);
-        gEntropy -= prob * log2(prob);
-    }
-    
-    for (const auto& pair : bHist) {
-        double prob = pair.second / static_cast<double>(totalPixels);
-        bEntropy -= prob * log2(prob);
-    }
-    
-    return (rEntropy + gEntropy + bEntropy) / (3.0 * maxEntropy);
+    return evaluateBlock<EntropyMetric>(block, rMean, gMean, bMean);
 }
 
-void ErrorCalculator::calculateMeans(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean) {
-    rMean = gMean = bMean = 0.0;
-    int count = 0;
-    
-    for (const auto& row : block) {
-        for (const Pixel& p : row) {
-            rMean += p.r;
-            gMean += p.g;
-            bMean += p.b;
-            count++;
+double ErrorCalculator::calculateSSIM(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean) {
+    return evaluateBlock<SSIMMetric>(block, rMean, gMean, bMean);
+}
+
+double ErrorCalculator::calculatePlaneFit(const std::vector<std::vector<Pixel>>& block, double& rMean, double& gMean, double& bMean) {
+    // Same fit as MomentImage, using block-local coordinates
+    BlockStatistics stats;
+    double momentX[3] = {0, 0, 0}, momentY[3] = {0, 0, 0};
+    for (size_t y = 0; y < block.size(); y++) {
+        for (size_t x = 0; x < block[y].size(); x++) {
+            const Pixel& p = block[y][x];
+            stats.addPixel(p);
+            const double values[3] = {static_cast<double>(p.r), static_cast<double>(p.g), static_cast<double>(p.b)};
+            for (int c = 0; c < 3; c++) {
+                momentX[c] += x * values[c];
+                momentY[c] += y * values[c];
+            }
         }
     }
-    
-    if (count > 0) {
-        rMean /= count;
-        gMean /= count;
-        bMean /= count;
+    if (stats.count == 0 || block[0].empty()) {
+        rMean = gMean = bMean = 0.0;
+        return 0.0;
     }
-}
 
-void ErrorCalculator::calculateHistograms(const std::vector<std::vector<Pixel>>& block, std::map<uint8_t, int>& rHist, std::map<uint8_t, int>& gHist,std::map<uint8_t, int>& bHist) {
-    rHist.clear();
-    gHist.clear();
-    bHist.clear();
-    
-    for (const auto& row : block) {
-        for (const Pixel& p : row) {
-            rHist[p.r]++;
-            gHist[p.g]++;
-            bHist[p.b]++;
-        }
+    const double h = static_cast<double>(block.size()), w = static_cast<double>(block[0].size());
+    PlaneFit fit = {};
+    fit.channels = 3;
+    fit.count = stats.count;
+    fit.sumXX = h * w * (w * w - 1) / 12.0;
+    fit.sumYY = w * h * (h * h - 1) / 12.0;
+    for (int c = 0; c < 3; c++) {
+        double sum = static_cast<double>(stats.sum[c]);
+        double mx = momentX[c] - (w - 1) / 2.0 * sum;
+        double my = momentY[c] - (h - 1) / 2.0 * sum;
+        fit.mean[c] = sum / stats.count;
+        fit.gradientX[c] = fit.sumXX > 0 ? mx / fit.sumXX : 0.0;
+        fit.gradientY[c] = fit.sumYY > 0 ? my / fit.sumYY : 0.0;
+        fit.residual[c] = std::max(static_cast<double>(stats.sumSquares[c]) - sum * fit.mean[c]
+                                   - fit.gradientX[c] * mx - fit.gradientY[c] * my, 0.0);
     }
+    double means[3];
+    double error = calculatePlaneResidual(fit, means);
+    rMean = means[0];
+    gMean = means[1];
+    bMean = means[2];
+    return error;
 }
 
+double ErrorCalculator::calculatePlaneResidual(const PlaneFit& fit, double* means) {
+    double residual = 0;
+    for (int c = 0; c < fit.channels; c++) {
+        means[c] = fit.mean[c];
+        residual += fit.residual[c];
+    }
+    if (fit.count == 0) return 0.0;
+
+    // Same scale as VarianceMetric: mean over channels of residual variance / (255^2 / 4)
+    return 4.0 * residual / (static_cast<double>(fit.count) * (fit.channels * 65025));
+}
@@ -1,45 +1,29 @@
 #include "../header/ImagePixel.hpp"
+#include "../header/MortonTiles.hpp"
+#include <algorithm>
 
-ImagePixel::ImagePixel() : width(0), height(0) {}
+ImagePixel::ImagePixel() : width(0), height(0), channels(3) {}
 ImagePixel::~ImagePixel() = default;
 
 bool ImagePixel::loadImage(const std::string& filepath) {
-    int channels;
-    unsigned char* data = stbi_load(filepath.c_str(), &width, &height, &channels, 3);
+    // Load in the file's own layout instead of forcing RGB
+    unsigned char* data = stbi_load(filepath.c_str(), &width, &height, &channels, 0);
     if (!data) {
         return false;
     }
-
-    pixelMatrix.resize(height, std::vector<Pixel>(width));
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int index = (y * width + x) * 3;
-            pixelMatrix[y][x] = Pixel(data[index], data[index+1], data[index+2]);
-        }
-    }
-
+    mortonTiles.reset();
+    samples.assign(data, data + static_cast<size_t>(width) * height * channels);
     stbi_image_free(data);
     return true;
 }
 
 bool ImagePixel::saveImage(const std::string& filepath) const {
-    std::vector<unsigned char> data(width * height * 3);
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int index = (y * width + x) * 3;
-            data[index] = pixelMatrix[y][x].r;
-            data[index+1] = pixelMatrix[y][x].g;
-            data[index+2] = pixelMatrix[y][x].b;
-        }
-    }
-
+    // PNG keeps alpha; JPEG has none, so stb drops it from 2 and 4 channel layouts
     std::string ext = filepath.substr(filepath.find_last_of(".") + 1);
     if (ext == "png") {
-        return stbi_write_png(filepath.c_str(), width, height, 3, data.data(), width * 3);
+        return stbi_write_png(filepath.c_str(), width, height, channels, samples.data(), width * channels);
     } else if (ext == "jpg" || ext == "jpeg") {
-        return stbi_write_jpg(filepath.c_str(), width, height, 3, data.data(), 90);
+        return stbi_write_jpg(filepath.c_str(), width, height, channels, samples.data(), 90);
     }
 
     return false;
@@ -47,32 +31,70 @@ bool ImagePixel::saveImage(const std::string& filepath) const {
 
 int ImagePixel::getWidth() const { return width; }
 int ImagePixel::getHeight() const { return height; }
+int ImagePixel::getChannels() const { return channels; }
+
+const std::vector<uint8_t>& ImagePixel::getSamples() const { return samples; }
 
-const std::vector<std::vector<Pixel>>& ImagePixel::getPixelMatrix() const { return pixelMatrix; }
-std::vector<std::vector<Pixel>>& ImagePixel::getPixelMatrix() { return pixelMatrix; }
+const uint8_t* ImagePixel::getRow(int y) const {
+    return samples.data() + static_cast<size_t>(y) * width * channels;
+}
 
 Pixel ImagePixel::getPixel(int x, int y) const {
     if (x < 0 || x >= width || y < 0 || y >= height) {
         throw std::out_of_range("Pixel coordinates out of range");
     }
-    return pixelMatrix[y][x];
+    return ChannelLayout::compose(getRow(y) + static_cast<size_t>(x) * channels, channels);
 }
 
 void ImagePixel::setPixel(int x, int y, const Pixel& pixel) {
-    if (x < 0 || x >= width || y < 0 || y >= height) {
+    fillSpan(y, x, x + 1, pixel);
+}
+
+void ImagePixel::fillSpan(int y, int left, int right, const Pixel& color) {
+    if (left < 0 || right > width || left > right || y < 0 || y >= height) {
         throw std::out_of_range("Pixel coordinates out of range");
     }
-    pixelMatrix[y][x] = pixel;
+    mortonTiles.reset();
+    uint8_t value[ChannelLayout::maxChannels];
+    ChannelLayout::extract(color, channels, value);
+    uint8_t* out = samples.data() + (static_cast<size_t>(y) * width + left) * channels;
+    if (channels == 1) {
+        std::fill(out, out + (right - left), value[0]);
+        return;
+    }
+    for (int x = left; x < right; x++, out += channels) std::copy(value, value + channels, out);
 }
 
-void ImagePixel::createFromMatrix(const std::vector<std::vector<Pixel>>& matrix) {
-    if (matrix.empty() || matrix[0].empty()) {
-        width = height = 0;
-        pixelMatrix.clear();
-        return;
+void ImagePixel::create(int width, int height, int channels) {
+    if (width < 0 || height < 0) throw std::invalid_argument("Image size must not be negative");
+    if (channels < 1 || channels > ChannelLayout::maxChannels) {
+        throw std::invalid_argument("Unsupported channel count");
     }
+    std::vector<uint8_t> black(static_cast<size_t>(width) * height * channels, 0);
+    // Layouts with alpha keep it last
+    if (channels == 2 || channels == 4) {
+        for (size_t i = channels - 1; i < black.size(); i += channels) black[i] = 255;
+    }
+    createFromSamples(std::move(black), width, height, channels);
+}
+
+void ImagePixel::createFromSamples(std::vector<uint8_t>&& samples, int width, int height, int channels) {
+    if (channels < 1 || channels > ChannelLayout::maxChannels) {
+        throw std::invalid_argument("Unsupported channel count");
+    }
+    if (width <= 0 || height <= 0) width = height = 0;
+    if (samples.size() != static_cast<size_t>(width) * height * channels) {
+        throw std::invalid_argument("Sample count does not match the image size");
+    }
+    this->width = width;
+    this->height = height;
+    this->channels = channels;
+    this->samples = std::move(samples);
+    mortonTiles.reset();
+}
+
+void ImagePixel::enableMortonTiles() {
+    if (!mortonTiles) mortonTiles = std::make_shared<const MortonTiles>(*this);
+}
 
-    height = matrix.size();
-    width = matrix[0].size();
-    pixelMatrix = matrix;
-}
\ No newline at end of file
+const MortonTiles* ImagePixel::getMortonTiles() const { return mortonTiles.get(); }
@@ -0,0 +1,247 @@
+#include "../header/LinearQuadTree.hpp"
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <stdexcept>
+
+LinearQuadTree::LinearQuadTree() : width(0), height(0), channels(3) {}
+
+LinearQuadTree::LinearQuadTree(int width, int height, int channels, std::vector<LinearLeaf> leaves)
+    : width(width), height(height), channels(channels), leaves(std::move(leaves)) {
+    if (channels < 1 || channels > ChannelLayout::maxChannels) {
+        throw std::invalid_argument("Unsupported channel count");
+    }
+    // Sorted leaves of a quad subdivision tile the code space: each starts where the one before
+    // ends, the first at code 0, and the last ends at the root's span. Like the compressor's
+    // trees, they cover at least a pixel each, so no split goes below a block 2 pixels across
+    uint64_t next = 0;
+    for (const LinearLeaf& leaf : this->leaves) {
+        if (leaf.level > static_cast<uint32_t>(maxLevels) || leaf.code != next || next >= span(0) ||
+            (leaf.code & (span(leaf.level) - 1)) != 0) {
+            throw std::invalid_argument("Linear quadtree leaves must tile the image in code order");
+        }
+        BlockRect block = blockOf(leaf);
+        if (block.width == 0 || block.height == 0) {
+            throw std::invalid_argument("Linear quadtree leaves must cover at least one pixel");
+        }
+        next += span(leaf.level);
+    }
+    if (!this->leaves.empty() && next != span(0)) {
+        throw std::invalid_argument("Linear quadtree leaves must tile the image in code order");
+    }
+}
+
+LinearQuadTree LinearQuadTree::fromTree(const QuadTreeNode* root, int width, int height, int channels) {
+    std::vector<LinearLeaf> leaves;
+    if (root) appendTree(root, 0, 0, leaves);
+    return LinearQuadTree(width, height, channels, std::move(leaves));
+}
+
+LinearQuadTree LinearQuadTree::buildBottomUp(const StatisticsPyramid& pyramid, ErrorCalculator::ErrorMethod method,
+                                             double threshold, int minBlockSize) {
+    if (method == ErrorCalculator::PLANE_RESIDUAL) {
+        throw std::invalid_argument("Linear quadtrees hold flat leaves only");
+    }
+    const ImagePixel& image = pyramid.getImage();
+    std::vector<LinearLeaf> leaves;
+    BlockStatistics stats;
+    mergeBottomUp(pyramid, method, threshold, minBlockSize, BlockRect{0, 0, image.getWidth(), image.getHeight()},
+                  0, 0, stats, leaves);
+    return LinearQuadTree(image.getWidth(), image.getHeight(), image.getChannels(), std::move(leaves));
+}
+
+int LinearQuadTree::getWidth() const { return width; }
+int LinearQuadTree::getHeight() const { return height; }
+int LinearQuadTree::getChannels() const { return channels; }
+const std::vector<LinearLeaf>& LinearQuadTree::getLeaves() const { return leaves; }
+
+size_t LinearQuadTree::memoryBytes() const {
+    return sizeof(LinearQuadTree) + leaves.size() * sizeof(LinearLeaf);
+}
+
+BlockRect LinearQuadTree::blockOf(const LinearLeaf& leaf) const {
+    BlockRect block = {0, 0, width, height};
+    for (int level = 0; level < static_cast<int>(leaf.level); level++) {
+        int quadrant = static_cast<int>(leaf.code >> (2 * (maxLevels - level - 1))) & 3;
+        block = childBlock(block, quadrant);
+    }
+    return block;
+}
+
+const LinearLeaf& LinearQuadTree::leafAt(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height || leaves.empty()) {
+        throw std::out_of_range("Pixel coordinates out of range");
+    }
+    // Code of the pixel down to the first block that cannot split, which no leaf lies below (see
+    // the constructor); its leaf is the last one whose code does not exceed it
+    BlockRect block = {0, 0, width, height};
+    uint64_t code = 0;
+    for (int level = 0; level < maxLevels && block.width >= 2 && block.height >= 2; level++) {
+        int quadrant = (x >= block.x + block.width / 2 ? 1 : 0) + (y >= block.y + block.height / 2 ? 2 : 0);
+        code = childCode(code, level, quadrant);
+        block = childBlock(block, quadrant);
+    }
+    auto it = std::upper_bound(leaves.begin(), leaves.end(), code,
+                               [](uint64_t value, const LinearLeaf& leaf) { return value < leaf.code; });
+    if (it == leaves.begin()) throw std::out_of_range("No leaf covers the pixel");
+    return *(it - 1);
+}
+
+void LinearQuadTree::leavesInRect(const BlockRect& rect, std::vector<size_t>& indices) const {
+    indices.clear();
+    if (leaves.empty()) return;
+    collectInRect(BlockRect{0, 0, width, height}, 0, 0, rect, indices);
+}
+
+void LinearQuadTree::reconstruct(ImagePixel& outputImage) const {
+    outputImage.create(width, height, channels);
+    for (const LinearLeaf& leaf : leaves) {
+        BlockRect block = blockOf(leaf);
+        for (int y = block.y; y < block.y + block.height; y++) {
+            outputImage.fillSpan(y, block.x, block.x + block.width, leaf.color);
+        }
+    }
+}
+
+static void writeUint32(std::ofstream& file, uint32_t value) {
+    const uint8_t bytes[4] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+                              static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+    file.write(reinterpret_cast<const char*>(bytes), 4);
+}
+
+static uint32_t readUint32(const uint8_t* bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+bool LinearQuadTree::saveToFile(const std::string& filepath) const {
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file) return false;
+    file.write("QTL1", 4);
+    writeUint32(file, static_cast<uint32_t>(width));
+    writeUint32(file, static_cast<uint32_t>(height));
+    writeUint32(file, static_cast<uint32_t>(channels));
+    writeUint32(file, static_cast<uint32_t>(leaves.size()));
+    file.write(reinterpret_cast<const char*>(leaves.data()), leaves.size() * sizeof(LinearLeaf));
+    return static_cast<bool>(file);
+}
+
+bool LinearQuadTree::loadFromFile(const std::string& filepath, LinearQuadTree& tree) {
+    std::ifstream file(filepath, std::ios::binary);
+    uint8_t header[20];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+    if (std::string(reinterpret_cast<char*>(header), 4) != "QTL1") {
+        throw std::invalid_argument("Not a linear quadtree file");
+    }
+    const uint32_t width = readUint32(header + 4), height = readUint32(header + 8);
+    const uint32_t count = readUint32(header + 16);
+    if (width > static_cast<uint32_t>(INT_MAX) || height > static_cast<uint32_t>(INT_MAX)) {
+        throw std::invalid_argument("Corrupt linear quadtree file: image size out of range");
+    }
+    // The records fill the rest of the file, and a tree has at most one leaf per pixel
+    file.seekg(0, std::ios::end);
+    const uint64_t recordBytes = static_cast<uint64_t>(file.tellg()) - sizeof(header);
+    if (recordBytes != static_cast<uint64_t>(count) * sizeof(LinearLeaf) ||
+        count > static_cast<uint64_t>(width) * height) {
+        throw std::invalid_argument("Corrupt linear quadtree file: leaf count does not match");
+    }
+    file.seekg(sizeof(header));
+    std::vector<LinearLeaf> leaves(count);
+    if (!file.read(reinterpret_cast<char*>(leaves.data()), leaves.size() * sizeof(LinearLeaf))) return false;
+    tree = LinearQuadTree(static_cast<int>(width), static_cast<int>(height),
+                          static_cast<int>(readUint32(header + 12)), std::move(leaves));
+    return true;
+}
+
+uint64_t LinearQuadTree::childCode(uint64_t code, int level, int quadrant) {
+    return code | (static_cast<uint64_t>(quadrant) << (2 * (maxLevels - level - 1)));
+}
+
+uint64_t LinearQuadTree::span(int level) {
+    return uint64_t(1) << (2 * (maxLevels - level));
+}
+
+// Same quadrant geometry as QuadTreeCompressor::splitBlock
+BlockRect LinearQuadTree::childBlock(const BlockRect& block, int quadrant) {
+    int halfWidth = block.width / 2;
+    int halfHeight = block.height / 2;
+    BlockRect child = block;
+    if (quadrant & 1) {
+        child.x += halfWidth;
+        child.width -= halfWidth;
+    } else {
+        child.width = halfWidth;
+    }
+    if (quadrant & 2) {
+        child.y += halfHeight;
+        child.height -= halfHeight;
+    } else {
+        child.height = halfHeight;
+    }
+    return child;
+}
+
+std::pair<size_t, size_t> LinearQuadTree::leafRange(uint64_t code, int level) const {
+    auto byCode = [](const LinearLeaf& leaf, uint64_t value) { return leaf.code < value; };
+    auto first = std::lower_bound(leaves.begin(), leaves.end(), code, byCode);
+    auto last = std::lower_bound(first, leaves.end(), code + span(level), byCode);
+    return {static_cast<size_t>(first - leaves.begin()), static_cast<size_t>(last - leaves.begin())};
+}
+
+void LinearQuadTree::collectInRect(const BlockRect& block, uint64_t code, int level, const BlockRect& rect,
+                                   std::vector<size_t>& indices) const {
+    if (block.x >= rect.x + rect.width || rect.x >= block.x + block.width ||
+        block.y >= rect.y + rect.height || rect.y >= block.y + block.height) {
+        return;
+    }
+    std::pair<size_t, size_t> range = leafRange(code, level);
+    if (range.first == range.second) return;
+    // A node holding a single leaf is that leaf; so is a block lying inside the rectangle
+    bool inside = block.x >= rect.x && block.y >= rect.y &&
+                  block.x + block.width <= rect.x + rect.width && block.y + block.height <= rect.y + rect.height;
+    if (range.second - range.first == 1 || inside) {
+        for (size_t i = range.first; i < range.second; i++) indices.push_back(i);
+        return;
+    }
+    for (int quadrant = 0; quadrant < 4; quadrant++) {
+        collectInRect(childBlock(block, quadrant), childCode(code, level, quadrant), level + 1, rect, indices);
+    }
+}
+
+void LinearQuadTree::appendTree(const QuadTreeNode* node, uint64_t code, int level, std::vector<LinearLeaf>& leaves) {
+    if (node->isLeaf) {
+        if (node->hasGradient) throw std::invalid_argument("Linear quadtrees hold flat leaves only");
+        leaves.push_back(LinearLeaf{code, static_cast<uint32_t>(level), node->averageColor});
+        return;
+    }
+    for (int quadrant = 0; quadrant < 4; quadrant++) {
+        if (!node->children[quadrant]) throw std::invalid_argument("Linear quadtrees need quad splits");
+    }
+    if (level + 1 > maxLevels) throw std::invalid_argument("Quadtree too deep for a linear quadtree");
+    for (int quadrant = 0; quadrant < 4; quadrant++) {
+        appendTree(node->children[quadrant].get(), childCode(code, level, quadrant), level + 1, leaves);
+    }
+}
+
+void LinearQuadTree::mergeBottomUp(const StatisticsPyramid& pyramid, ErrorCalculator::ErrorMethod method,
+                                   double threshold, int minBlockSize, const BlockRect& block, uint64_t code,
+                                   int level, BlockStatistics& stats, std::vector<LinearLeaf>& leaves) {
+    // Children first: their leaves stay unless this block turns out uniform enough
+    bool splittable = QuadTreeCompressor::canSplit(block.width, block.height, minBlockSize) && level < maxLevels;
+    size_t firstChildLeaf = leaves.size();
+    if (splittable) {
+        for (int quadrant = 0; quadrant < 4; quadrant++) {
+            mergeBottomUp(pyramid, method, threshold, minBlockSize, childBlock(block, quadrant),
+                          childCode(code, level, quadrant), level + 1, stats, leaves);
+        }
+    }
+
+    pyramid.query(block.x, block.y, block.width, block.height, stats, ErrorCalculator::requiresHistogram(method));
+    double values[ChannelLayout::maxChannels];
+    double error = ErrorCalculator::calculateError(method, stats, values);
+    if (splittable && error > threshold) return;
+
+    uint8_t samples[ChannelLayout::maxChannels];
+    for (int c = 0; c < stats.channels; c++) samples[c] = static_cast<uint8_t>(values[c]);
+    leaves.resize(firstChildLeaf);
+    leaves.push_back(LinearLeaf{code, static_cast<uint32_t>(level), ChannelLayout::compose(samples, stats.channels)});
+}
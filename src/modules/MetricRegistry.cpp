@@ -0,0 +1,132 @@
+#include "../header/MetricRegistry.hpp"
+#include "../header/ErrorCalculator.hpp"
+#include <sstream>
+#include <stdexcept>
+
+// The built-in statistics metrics share their formulas with the compile-time ones (see BlockMetrics.hpp)
+static double varianceError(const BlockStatistics& stats, double* means) {
+    return VarianceMetric::finalize(stats, stats.channels, means);
+}
+
+static double madError(const BlockStatistics& stats, double* means) {
+    return MeanAbsoluteDeviationMetric::finalize(stats, stats.channels, means);
+}
+
+static double maxDiffError(const BlockStatistics& stats, double* midpoints) {
+    return MaxDifferenceMetric::finalize(stats, stats.channels, midpoints);
+}
+
+static double entropyError(const BlockStatistics& stats, double* means) {
+    return EntropyMetric::finalize(stats, stats.channels, means);
+}
+
+static double ssimError(const BlockStatistics& stats, double* means) {
+    return SSIMMetric::finalize(stats, stats.channels, means);
+}
+
+std::vector<MetricDescriptor>& MetricRegistry::entries() {
+    // Listed in ErrorMethod order, so that id == index + 1
+    static std::vector<MetricDescriptor> metrics = {
+        {ErrorCalculator::VARIANCE, "variance", "Variance",
+         SUM_STATISTICS | SQUARE_STATISTICS, varianceError, {}},
+        {ErrorCalculator::MEAN_ABSOLUTE_DEVIATION, "mad", "Mean Absolute Deviation",
+         SUM_STATISTICS | HISTOGRAM_STATISTICS, madError, {}},
+        {ErrorCalculator::MAX_PIXEL_DIFFERENCE, "maxdiff", "Max Pixel Difference",
+         RANGE_STATISTICS, maxDiffError, {}},
+        {ErrorCalculator::ENTROPY, "entropy", "Entropy",
+         SUM_STATISTICS | HISTOGRAM_STATISTICS, entropyError, {}},
+        {ErrorCalculator::SSIM, "ssim", "Structural Similarity (SSIM)",
+         SUM_STATISTICS | SQUARE_STATISTICS, ssimError, {}},
+        {ErrorCalculator::PLANE_RESIDUAL, "plane", "Plane Fit Residual",
+         SUM_STATISTICS | SQUARE_STATISTICS | PLANE_STATISTICS, nullptr, {}},
+    };
+    return metrics;
+}
+
+int MetricRegistry::add(const std::string& key, const std::string& label, unsigned statistics,
+                        double (*evaluate)(const BlockStatistics&, double*)) {
+    if (!evaluate) throw std::invalid_argument("Metric " + key + " needs an evaluator");
+    if (find(key)) throw std::invalid_argument("Metric already registered: " + key);
+    std::vector<MetricDescriptor>& metrics = entries();
+    int id = static_cast<int>(metrics.size()) + 1;
+    metrics.push_back({id, key, label, statistics, evaluate, {}});
+    return id;
+}
+
+int MetricRegistry::combine(const std::vector<int>& ids) {
+    if (ids.empty()) throw std::invalid_argument("Combined metric needs at least one component");
+    if (ids.size() == 1) return get(ids[0]).id;
+
+    std::string key, label;
+    unsigned statistics = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+        const MetricDescriptor& component = get(ids[i]);
+        if (!component.evaluate) {
+            throw std::invalid_argument(component.label + " cannot be combined with other metrics");
+        }
+        key += (i ? "+" : "") + component.key;
+        label += (i ? " + " : "") + component.label;
+        statistics |= component.statistics;
+    }
+    if (const MetricDescriptor* existing = find(key)) return existing->id;
+
+    std::vector<MetricDescriptor>& metrics = entries();
+    int id = static_cast<int>(metrics.size()) + 1;
+    metrics.push_back({id, key, label, statistics, nullptr, ids});
+    return id;
+}
+
+int MetricRegistry::parse(const std::string& spec) {
+    std::vector<int> ids;
+    std::stringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, '+')) {
+        if (item.empty()) continue;
+        if (item.find_first_not_of("0123456789") == std::string::npos) {
+            ids.push_back(get(std::stoi(item)).id);
+        } else if (const MetricDescriptor* metric = find(item)) {
+            ids.push_back(metric->id);
+        } else {
+            throw std::invalid_argument("Unknown error method: " + item);
+        }
+    }
+    if (ids.empty()) throw std::invalid_argument("Invalid error method");
+    return combine(ids);
+}
+
+const MetricDescriptor& MetricRegistry::get(int id) {
+    const std::vector<MetricDescriptor>& metrics = entries();
+    if (id < 1 || id > static_cast<int>(metrics.size())) throw std::invalid_argument("Invalid error method");
+    return metrics[id - 1];
+}
+
+const MetricDescriptor* MetricRegistry::find(const std::string& key) {
+    for (const MetricDescriptor& metric : entries()) {
+        if (metric.key == key) return &metric;
+    }
+    return nullptr;
+}
+
+const std::vector<MetricDescriptor>& MetricRegistry::all() { return entries(); }
+
+double MetricRegistry::evaluate(int id, const BlockStatistics& stats, double* values) {
+    const MetricDescriptor& metric = get(id);
+    if ((metric.statistics & HISTOGRAM_STATISTICS) && !stats.hasHistogram()) {
+        throw std::invalid_argument(metric.label + " requires block histograms");
+    }
+    if (!metric.components.empty()) return evaluateCombined(metric, stats, values);
+    if (!metric.evaluate) throw std::invalid_argument(metric.label + " is evaluated from a plane fit");
+    return metric.evaluate(stats, values);
+}
+
+unsigned MetricRegistry::statisticsOf(int id) { return get(id).statistics; }
+
+double MetricRegistry::evaluateCombined(const MetricDescriptor& metric, const BlockStatistics& stats, double* values) {
+    // The first component supplies the block's representative values
+    double error = get(metric.components[0]).evaluate(stats, values);
+    double scratch[ChannelLayout::maxChannels];
+    for (size_t i = 1; i < metric.components.size(); i++) {
+        error = std::max(error, get(metric.components[i]).evaluate(stats, scratch));
+    }
+    return error;
+}
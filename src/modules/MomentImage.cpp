@@ -0,0 +1,70 @@
+#include "../header/MomentImage.hpp"
+#include <algorithm>
+
+MomentImage::MomentImage(const ImagePixel& image)
+    : width(image.getWidth()), height(image.getHeight()), channels(image.getChannels()) {
+    ChannelLayout::dispatch(channels, [&](auto layout) { build<decltype(layout)::value>(image); });
+}
+
+template <int C>
+void MomentImage::build(const ImagePixel& image) {
+    const size_t stride = static_cast<size_t>(width + 1) * C;
+    sumXV.assign(stride * (height + 1), 0);
+    sumYV.assign(stride * (height + 1), 0);
+
+    for (int y = 0; y < height; y++) {
+        int64_t rowXV[C] = {}, rowYV[C] = {};
+        const uint8_t* row = image.getRow(y);
+        for (int x = 0; x < width; x++) {
+            const uint8_t* samples = row + x * C;
+            size_t above = static_cast<size_t>(y) * stride + static_cast<size_t>(x + 1) * C;
+            size_t here = above + stride;
+            for (int c = 0; c < C; c++) {
+                rowXV[c] += static_cast<int64_t>(x) * samples[c];
+                rowYV[c] += static_cast<int64_t>(y) * samples[c];
+                sumXV[here + c] = sumXV[above + c] + rowXV[c];
+                sumYV[here + c] = sumYV[above + c] + rowYV[c];
+            }
+        }
+    }
+}
+
+int64_t MomentImage::rectSum(const std::vector<int64_t>& table, int x0, int y0, int x1, int y1, int channel) const {
+    const size_t stride = static_cast<size_t>(width + 1) * channels;
+    return table[y1 * stride + x1 * channels + channel] - table[y0 * stride + x1 * channels + channel]
+         - table[y1 * stride + x0 * channels + channel] + table[y0 * stride + x0 * channels + channel];
+}
+
+PlaneFit MomentImage::fit(int x, int y, int blockWidth, int blockHeight, const BlockStatistics& stats) const {
+    PlaneFit result = {};
+    result.channels = channels;
+    int x0 = std::max(x, 0), y0 = std::max(y, 0);
+    int x1 = std::min(x + blockWidth, width), y1 = std::min(y + blockHeight, height);
+    if (x0 >= x1 || y0 >= y1 || stats.count == 0) return result;
+
+    const double w = x1 - x0, h = y1 - y0;
+    const double n = static_cast<double>(stats.count);
+    const double centerX = x0 + (w - 1) / 2.0, centerY = y0 + (h - 1) / 2.0;
+    // Sums of squared centered coordinates over the rectangle
+    const double sxx = h * w * (w * w - 1) / 12.0;
+    const double syy = w * h * (h * h - 1) / 12.0;
+
+    result.count = stats.count;
+    result.sumXX = sxx;
+    result.sumYY = syy;
+    for (int c = 0; c < channels; c++) {
+        double sum = static_cast<double>(stats.sum[c]);
+        double mean = sum / n;
+        double momentX = static_cast<double>(rectSum(sumXV, x0, y0, x1, y1, c)) - centerX * sum;
+        double momentY = static_cast<double>(rectSum(sumYV, x0, y0, x1, y1, c)) - centerY * sum;
+
+        result.mean[c] = mean;
+        result.gradientX[c] = sxx > 0 ? momentX / sxx : 0.0;
+        result.gradientY[c] = syy > 0 ? momentY / syy : 0.0;
+
+        double residual = static_cast<double>(stats.sumSquares[c]) - sum * mean
+                        - result.gradientX[c] * momentX - result.gradientY[c] * momentY;
+        result.residual[c] = std::max(residual, 0.0);
+    }
+    return result;
+}
@@ -0,0 +1,15 @@
+#include "../header/MortonTiles.hpp"
+
+MortonTiles::MortonTiles(const ImagePixel& image)
+    : width(image.getWidth()), height(image.getHeight()), channels(image.getChannels()),
+      tilesAcross((image.getWidth() + tileSize - 1) >> tileShift) {
+    int tilesDown = (height + tileSize - 1) >> tileShift;
+    samples.resize(static_cast<size_t>(tilesAcross) * tilesDown * tilePixels * channels);
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = image.getRow(y);
+        for (int x = 0; x < width; x++) {
+            std::copy(row + x * channels, row + (x + 1) * channels, &samples[offsetOf(x, y) * channels]);
+        }
+    }
+}
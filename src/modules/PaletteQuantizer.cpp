@@ -0,0 +1,147 @@
+#include "../header/PaletteQuantizer.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+
+std::vector<Pixel> PaletteQuantizer::build(const std::vector<Pixel>& colors, const std::vector<uint64_t>& weights,
+                                           int paletteSize, std::vector<int>& assignment) {
+    if (paletteSize < 2 || paletteSize > 256) throw std::invalid_argument("Palette size must be in 2-256");
+    if (colors.size() != weights.size()) throw std::invalid_argument("Every color needs a weight");
+
+    // Merge duplicate colors so the clustering works on distinct values only
+    std::unordered_map<uint32_t, int> uniqueIndex;
+    std::vector<WeightedColor> unique;
+    std::vector<int> colorToUnique(colors.size());
+    for (size_t i = 0; i < colors.size(); i++) {
+        uint32_t key = (static_cast<uint32_t>(colors[i].r) << 24) | (colors[i].g << 16) | (colors[i].b << 8) | colors[i].a;
+        auto it = uniqueIndex.find(key);
+        if (it == uniqueIndex.end()) {
+            it = uniqueIndex.emplace(key, static_cast<int>(unique.size())).first;
+            unique.push_back(WeightedColor{{colors[i].r, colors[i].g, colors[i].b, colors[i].a}, 0});
+        }
+        unique[it->second].weight += weights[i];
+        colorToUnique[i] = it->second;
+    }
+
+    std::vector<Pixel> palette;
+    if (static_cast<int>(unique.size()) <= paletteSize) {
+        for (const WeightedColor& color : unique) {
+            palette.push_back(Pixel(color.value[0], color.value[1], color.value[2], color.value[3]));
+        }
+    } else {
+        std::vector<WeightedColor> working(unique);
+        palette = medianCut(working, paletteSize);
+
+        // Weighted k-means refinement
+        std::vector<int> cluster(unique.size(), -1);
+        for (int pass = 0; pass < refinePasses; pass++) {
+            bool changed = false;
+            std::vector<uint64_t> sums(palette.size() * 5, 0);
+            for (size_t i = 0; i < unique.size(); i++) {
+                int best = nearest(palette, unique[i].value);
+                changed = changed || best != cluster[i];
+                cluster[i] = best;
+                for (int c = 0; c < 4; c++) sums[best * 5 + c] += unique[i].value[c] * unique[i].weight;
+                sums[best * 5 + 4] += unique[i].weight;
+            }
+            if (!changed) break;
+            for (size_t k = 0; k < palette.size(); k++) {
+                uint64_t weight = sums[k * 5 + 4];
+                if (weight == 0) continue;
+                palette[k] = Pixel(static_cast<uint8_t>((sums[k * 5] + weight / 2) / weight),
+                                   static_cast<uint8_t>((sums[k * 5 + 1] + weight / 2) / weight),
+                                   static_cast<uint8_t>((sums[k * 5 + 2] + weight / 2) / weight),
+                                   static_cast<uint8_t>((sums[k * 5 + 3] + weight / 2) / weight));
+            }
+        }
+    }
+
+    std::vector<int> uniqueAssignment(unique.size());
+    for (size_t i = 0; i < unique.size(); i++) uniqueAssignment[i] = nearest(palette, unique[i].value);
+
+    assignment.resize(colors.size());
+    for (size_t i = 0; i < colors.size(); i++) assignment[i] = uniqueAssignment[colorToUnique[i]];
+    return palette;
+}
+
+std::vector<Pixel> PaletteQuantizer::medianCut(std::vector<WeightedColor>& colors, int paletteSize) {
+    struct Box {
+        size_t begin, end;
+        int channel;
+        int range;
+    };
+
+    auto describe = [&colors](size_t begin, size_t end) {
+        Box box = {begin, end, 0, 0};
+        for (int c = 0; c < 4; c++) {
+            int lo = 255, hi = 0;
+            for (size_t i = begin; i < end; i++) {
+                lo = std::min(lo, colors[i].value[c]);
+                hi = std::max(hi, colors[i].value[c]);
+            }
+            if (hi - lo > box.range) {
+                box.range = hi - lo;
+                box.channel = c;
+            }
+        }
+        return box;
+    };
+
+    std::vector<Box> boxes = {describe(0, colors.size())};
+    while (static_cast<int>(boxes.size()) < paletteSize) {
+        // Split the widest box at its weighted median
+        size_t widest = 0;
+        for (size_t i = 1; i < boxes.size(); i++) {
+            if (boxes[i].range > boxes[widest].range) widest = i;
+        }
+        Box box = boxes[widest];
+        if (box.range == 0) break;
+
+        int channel = box.channel;
+        std::sort(colors.begin() + box.begin, colors.begin() + box.end,
+                  [channel](const WeightedColor& a, const WeightedColor& b) { return a.value[channel] < b.value[channel]; });
+
+        uint64_t total = 0;
+        for (size_t i = box.begin; i < box.end; i++) total += colors[i].weight;
+        uint64_t running = 0;
+        size_t split = box.begin + 1;
+        for (size_t i = box.begin; i < box.end - 1; i++) {
+            running += colors[i].weight;
+            split = i + 1;
+            if (running * 2 >= total) break;
+        }
+
+        boxes[widest] = describe(box.begin, split);
+        boxes.push_back(describe(split, box.end));
+    }
+
+    std::vector<Pixel> palette;
+    for (const Box& box : boxes) {
+        uint64_t sums[4] = {0, 0, 0, 0}, weight = 0;
+        for (size_t i = box.begin; i < box.end; i++) {
+            for (int c = 0; c < 4; c++) sums[c] += colors[i].value[c] * colors[i].weight;
+            weight += colors[i].weight;
+        }
+        weight = std::max<uint64_t>(weight, 1);
+        palette.push_back(Pixel(static_cast<uint8_t>((sums[0] + weight / 2) / weight),
+                                static_cast<uint8_t>((sums[1] + weight / 2) / weight),
+                                static_cast<uint8_t>((sums[2] + weight / 2) / weight),
+                                static_cast<uint8_t>((sums[3] + weight / 2) / weight)));
+    }
+    return palette;
+}
+
+int PaletteQuantizer::nearest(const std::vector<Pixel>& palette, const int value[4]) {
+    int best = 0;
+    int bestDistance = -1;
+    for (size_t k = 0; k < palette.size(); k++) {
+        int dr = value[0] - palette[k].r, dg = value[1] - palette[k].g, db = value[2] - palette[k].b;
+        int da = value[3] - palette[k].a;
+        int distance = dr * dr + dg * dg + db * db + da * da;
+        if (bestDistance < 0 || distance < bestDistance) {
+            bestDistance = distance;
+            best = static_cast<int>(k);
+        }
+    }
+    return best;
+}
@@ -0,0 +1,406 @@
+#include "../header/PngWriter.hpp"
+#include "../header/Parallel.hpp"
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+
+// Deflate constants (RFC 1951)
+static const int minMatch = 3;
+static const int maxMatch = 258;
+static const size_t windowSize = 32768;
+static const int hashBits = 15;
+static const size_t maxStoredBlock = 65535;
+
+static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                          513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+                                          8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Fixed Huffman codes, bit-reversed since deflate packs codes from their top bit, and the symbol
+// lookups for match lengths and distances
+struct FixedCodes {
+    uint16_t literalCode[288];
+    uint8_t literalBits[288];
+    uint8_t distanceCode[30];
+    uint8_t lengthSymbol[maxMatch + 1];
+    uint8_t nearDistanceSymbol[257];  // distances 1..256
+    uint8_t farDistanceSymbol[256];   // distances 257..32768, by (distance - 1) >> 7
+
+    static uint32_t reverse(uint32_t code, int bits) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < bits; i++) reversed |= ((code >> i) & 1) << (bits - 1 - i);
+        return reversed;
+    }
+
+    FixedCodes() {
+        for (int symbol = 0; symbol < 288; symbol++) {
+            uint32_t code;
+            int bits;
+            if (symbol < 144) { code = 0x30 + symbol; bits = 8; }
+            else if (symbol < 256) { code = 0x190 + symbol - 144; bits = 9; }
+            else if (symbol < 280) { code = symbol - 256; bits = 7; }
+            else { code = 0xC0 + symbol - 280; bits = 8; }
+            literalCode[symbol] = static_cast<uint16_t>(reverse(code, bits));
+            literalBits[symbol] = static_cast<uint8_t>(bits);
+        }
+        for (int symbol = 0; symbol < 30; symbol++) distanceCode[symbol] = static_cast<uint8_t>(reverse(symbol, 5));
+        for (int symbol = 0; symbol < 29; symbol++) {
+            int last = symbol == 28 ? maxMatch : lengthBase[symbol] + (1 << lengthExtra[symbol]) - 1;
+            for (int length = lengthBase[symbol]; length <= last; length++) {
+                lengthSymbol[length] = static_cast<uint8_t>(symbol);
+            }
+        }
+        for (int symbol = 0; symbol < 30; symbol++) {
+            int last = distanceBase[symbol] + (1 << distanceExtra[symbol]) - 1;
+            for (int distance = distanceBase[symbol]; distance <= last; distance++) {
+                if (distance <= 256) nearDistanceSymbol[distance] = static_cast<uint8_t>(symbol);
+                else farDistanceSymbol[(distance - 1) >> 7] = static_cast<uint8_t>(symbol);
+            }
+        }
+    }
+};
+
+static const FixedCodes& fixedCodes() {
+    static const FixedCodes codes;
+    return codes;
+}
+
+// Appends bits least significant first, as deflate expects
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out(out), buffer(0), count(0) {}
+
+    void put(uint32_t bits, int length) {
+        buffer |= static_cast<uint64_t>(bits) << count;
+        count += length;
+        if (count >= 32) {
+            for (int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(buffer >> (8 * i)));
+            buffer >>= 32;
+            count -= 32;
+        }
+    }
+
+    // Pads with zero bits to the next byte boundary
+    void align() {
+        for (; count > 0; count -= 8) {
+            out.push_back(static_cast<uint8_t>(buffer));
+            buffer >>= 8;
+        }
+        buffer = 0;
+        count = 0;
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint64_t buffer;
+    int count;
+};
+
+static uint32_t hash3(const uint8_t* p) {
+    uint32_t value = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (value * 0x9E3779B1u) >> (32 - hashBits);
+}
+
+// One non-final fixed Huffman block holding data, then a sync flush (an empty stored block) so
+// that the next stripe starts on a byte boundary. probes is the match chain length per position;
+// positions inside a match are only indexed for matches up to maxInsert bytes, which keeps long
+// runs (flat regions filter to zeros) cheap
+static void deflateFixed(const uint8_t* data, size_t size, int probes, size_t maxInsert, std::vector<uint8_t>& out) {
+    const FixedCodes& codes = fixedCodes();
+    BitWriter bits(out);
+    bits.put(0, 1);  // BFINAL
+    bits.put(1, 2);  // BTYPE fixed Huffman
+
+    std::vector<int32_t> head(size_t(1) << hashBits, -1);
+    std::vector<int32_t> chain(probes > 1 ? windowSize : 0);
+    auto insert = [&](size_t position) {
+        uint32_t h = hash3(data + position);
+        if (probes > 1) chain[position & (windowSize - 1)] = head[h];
+        head[h] = static_cast<int32_t>(position);
+    };
+
+    size_t i = 0;
+    while (i < size) {
+        size_t bestLength = 0, bestDistance = 0;
+        if (i + minMatch <= size) {
+            size_t limit = std::min<size_t>(maxMatch, size - i);
+            int32_t candidate = head[hash3(data + i)];
+            for (int probe = 0; candidate >= 0 && probe < probes; probe++) {
+                size_t distance = i - candidate;
+                if (distance > windowSize) break;
+                if (data[candidate + bestLength] == data[i + bestLength]) {
+                    size_t length = 0;
+                    while (length < limit && data[candidate + length] == data[i + length]) length++;
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = distance;
+                        if (length == limit) break;
+                    }
+                }
+                if (probes == 1) break;
+                int32_t next = chain[candidate & (windowSize - 1)];
+                if (next >= candidate) break;  // slot reused by a newer position
+                candidate = next;
+            }
+            insert(i);
+        }
+
+        if (bestLength >= static_cast<size_t>(minMatch)) {
+            int lengthSymbol = codes.lengthSymbol[bestLength];
+            bits.put(codes.literalCode[257 + lengthSymbol], codes.literalBits[257 + lengthSymbol]);
+            bits.put(static_cast<uint32_t>(bestLength - lengthBase[lengthSymbol]), lengthExtra[lengthSymbol]);
+            int distanceSymbol = bestDistance <= 256 ? codes.nearDistanceSymbol[bestDistance]
+                                                     : codes.farDistanceSymbol[(bestDistance - 1) >> 7];
+            bits.put(codes.distanceCode[distanceSymbol], 5);
+            bits.put(static_cast<uint32_t>(bestDistance - distanceBase[distanceSymbol]), distanceExtra[distanceSymbol]);
+            if (bestLength <= maxInsert) {
+                for (size_t j = i + 1; j < i + bestLength && j + minMatch <= size; j++) insert(j);
+            }
+            i += bestLength;
+        } else {
+            bits.put(codes.literalCode[data[i]], codes.literalBits[data[i]]);
+            i++;
+        }
+    }
+
+    bits.put(codes.literalCode[256], codes.literalBits[256]);  // end of block
+    bits.put(0, 3);                                            // empty stored block
+    bits.align();
+    const uint8_t emptyStored[4] = {0x00, 0x00, 0xFF, 0xFF};
+    out.insert(out.end(), emptyStored, emptyStored + 4);
+}
+
+// Non-final stored blocks; they start and end on byte boundaries
+static void deflateStored(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    for (size_t offset = 0; offset < size; offset += maxStoredBlock) {
+        size_t length = std::min(maxStoredBlock, size - offset);
+        const uint8_t header[5] = {0x00, static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+                                   static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8)};
+        out.insert(out.end(), header, header + 5);
+        out.insert(out.end(), data + offset, data + offset + length);
+    }
+}
+
+static uint8_t paeth(int left, int up, int upLeft) {
+    int estimate = left + up - upLeft;
+    int toLeft = std::abs(estimate - left), toUp = std::abs(estimate - up), toUpLeft = std::abs(estimate - upLeft);
+    if (toLeft <= toUp && toLeft <= toUpLeft) return static_cast<uint8_t>(left);
+    return static_cast<uint8_t>(toUp <= toUpLeft ? up : upLeft);
+}
+
+// PNG filter type filter (0 None, 1 Sub, 2 Up, 3 Average, 4 Paeth) of row against the row above
+static void filterRow(int filter, const uint8_t* row, const uint8_t* above, size_t length, int bpp, uint8_t* out) {
+    for (size_t i = 0; i < length; i++) {
+        int left = i >= static_cast<size_t>(bpp) ? row[i - bpp] : 0;
+        int upLeft = i >= static_cast<size_t>(bpp) ? above[i - bpp] : 0;
+        int predicted = 0;
+        switch (filter) {
+            case 1: predicted = left; break;
+            case 2: predicted = above[i]; break;
+            case 3: predicted = (left + above[i]) / 2; break;
+            case 4: predicted = paeth(left, above[i], upLeft); break;
+        }
+        out[i] = static_cast<uint8_t>(row[i] - predicted);
+    }
+}
+
+PngWriter::PngWriter(int width, int height, int channels, int bitDepth)
+    : width(width), height(height), channels(channels), bitDepth(bitDepth), level(DEFAULT_LEVEL), stripes(0),
+      filters(nullptr) {
+    if (width <= 0 || height <= 0) throw std::invalid_argument("PNG images need a positive size");
+    if (channels < 1 || channels > ChannelLayout::maxChannels) {
+        throw std::invalid_argument("Unsupported channel count");
+    }
+    if (bitDepth != 8 && bitDepth != 16) throw std::invalid_argument("PNG bit depth must be 8 or 16");
+}
+
+void PngWriter::setLevel(Level level) { this->level = level; }
+
+void PngWriter::setStripes(int stripes) {
+    if (stripes < 0) throw std::invalid_argument("Stripe count cannot be negative");
+    this->stripes = stripes;
+}
+
+void PngWriter::setFilterSource(FilterSource filters) { this->filters = std::move(filters); }
+
+size_t PngWriter::rowBytes() const { return static_cast<size_t>(width) * bytesPerPixel(); }
+int PngWriter::bytesPerPixel() const { return channels * bitDepth / 8; }
+
+std::vector<uint8_t> PngWriter::encode(const RowSource& rows) const {
+    int stripeCount = stripes > 0 ? std::min(stripes, height) : Parallel::fixedChunks(height, defaultStripeRows);
+    std::vector<std::vector<uint8_t>> chunks(stripeCount);
+    std::vector<uint32_t> sums(stripeCount);
+    std::vector<size_t> lengths(stripeCount);
+    Parallel::forChunks(0, height, stripeCount, [&](int begin, int end, int index) {
+        encodeStripe(rows, begin, end, index == 0, chunks[index], sums[index], lengths[index]);
+    });
+
+    static const uint8_t colorTypes[5] = {0, 0, 4, 2, 6}; // gray, gray + alpha, RGB, RGBA
+    const uint8_t header[13] = {static_cast<uint8_t>(width >> 24), static_cast<uint8_t>(width >> 16),
+                                static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(width),
+                                static_cast<uint8_t>(height >> 24), static_cast<uint8_t>(height >> 16),
+                                static_cast<uint8_t>(height >> 8), static_cast<uint8_t>(height),
+                                static_cast<uint8_t>(bitDepth), colorTypes[channels], 0, 0, 0};
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    size_t total = 8 + 25 + 18 + 12;
+    for (const auto& chunk : chunks) total += chunk.size();
+    std::vector<uint8_t> out;
+    out.reserve(total);
+    out.insert(out.end(), signature, signature + 8);
+    appendChunk(out, "IHDR", header, sizeof(header));
+    uint32_t adler = sums[0];
+    for (int i = 0; i < stripeCount; i++) {
+        if (i > 0) adler = adler32Combine(adler, sums[i], lengths[i]);
+        out.insert(out.end(), chunks[i].begin(), chunks[i].end());
+    }
+
+    // Empty final fixed block, then the Adler-32 of the whole filtered image
+    const uint8_t trailer[6] = {0x03, 0x00, static_cast<uint8_t>(adler >> 24), static_cast<uint8_t>(adler >> 16),
+                                static_cast<uint8_t>(adler >> 8), static_cast<uint8_t>(adler)};
+    appendChunk(out, "IDAT", trailer, sizeof(trailer));
+    appendChunk(out, "IEND", nullptr, 0);
+    return out;
+}
+
+bool PngWriter::write(const std::string& filepath, const RowSource& rows) const {
+    std::vector<uint8_t> png = encode(rows);
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    return static_cast<bool>(file);
+}
+
+bool PngWriter::writeImage(const std::string& filepath, const ImagePixel& image, Level level, int stripes) {
+    PngWriter writer(image.getWidth(), image.getHeight(), image.getChannels());
+    writer.setLevel(level);
+    writer.setStripes(stripes);
+    const size_t rowSamples = static_cast<size_t>(image.getWidth()) * image.getChannels();
+    return writer.write(filepath, [&](int y, uint8_t* row) {
+        std::copy(image.getRow(y), image.getRow(y) + rowSamples, row);
+    });
+}
+
+void PngWriter::encodeStripe(const RowSource& rows, int begin, int end, bool first,
+                             std::vector<uint8_t>& chunk, uint32_t& adler, size_t& length) const {
+    const size_t lineBytes = rowBytes();
+    const int bpp = bytesPerPixel();
+    std::vector<uint8_t> filtered(static_cast<size_t>(end - begin) * (lineBytes + 1));
+    std::vector<uint8_t> above(lineBytes, 0), current(lineBytes), candidate(lineBytes);
+    if (begin > 0) rows(begin - 1, above.data());
+
+    for (int y = begin; y < end; y++) {
+        uint8_t* line = &filtered[static_cast<size_t>(y - begin) * (lineBytes + 1)];
+        RowFilter filter = filters ? filters(y) : ADAPTIVE_FILTER;
+        if (filter == REPEATED_ROW && y > 0) {
+            // The row above is still in place; the filtered buffer starts out zeroed
+            line[0] = UP_FILTER;
+            continue;
+        }
+        rows(y, current.data());
+        if (filter == ADAPTIVE_FILTER || filter == REPEATED_ROW) {
+            filter = level == DEFAULT_LEVEL ? ADAPTIVE_FILTER : UP_FILTER;
+        }
+        if (filter == ADAPTIVE_FILTER) {
+            // Smallest sum of signed residuals, the usual PNG heuristic
+            uint64_t bestCost = UINT64_MAX;
+            for (int candidateFilter = NONE_FILTER; candidateFilter <= PAETH_FILTER; candidateFilter++) {
+                filterRow(candidateFilter, current.data(), above.data(), lineBytes, bpp, candidate.data());
+                uint64_t cost = 0;
+                for (size_t i = 0; i < lineBytes; i++) cost += std::abs(static_cast<int8_t>(candidate[i]));
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    line[0] = static_cast<uint8_t>(candidateFilter);
+                    std::copy(candidate.begin(), candidate.end(), line + 1);
+                }
+            }
+        } else {
+            line[0] = static_cast<uint8_t>(filter);
+            filterRow(filter, current.data(), above.data(), lineBytes, bpp, line + 1);
+        }
+        std::swap(above, current);
+    }
+    adler = adler32(filtered.data(), filtered.size());
+    length = filtered.size();
+
+    // Chunk length and type first; the length is patched in once the data is known
+    chunk.assign({0, 0, 0, 0, 'I', 'D', 'A', 'T'});
+    if (first) {
+        chunk.push_back(0x78);
+        chunk.push_back(level == STORED_LEVEL ? 0x01 : level == FAST_LEVEL ? 0x5E : 0x9C);
+    }
+    size_t dataStart = chunk.size();
+    if (level != STORED_LEVEL) {
+        deflateFixed(filtered.data(), filtered.size(), level == FAST_LEVEL ? 1 : 16,
+                     level == FAST_LEVEL ? 4 : maxMatch, chunk);
+    }
+    // Stored blocks bound the size of data the fixed codes do not shrink
+    if (level == STORED_LEVEL || chunk.size() - dataStart > filtered.size() + 5 * (filtered.size() / maxStoredBlock + 1)) {
+        chunk.resize(dataStart);
+        deflateStored(filtered.data(), filtered.size(), chunk);
+    }
+
+    size_t payload = chunk.size() - 8;
+    for (int i = 0; i < 4; i++) chunk[i] = static_cast<uint8_t>(payload >> (24 - 8 * i));
+    uint32_t crc = crc32(chunk.data() + 4, chunk.size() - 4);
+    for (int i = 0; i < 4; i++) chunk.push_back(static_cast<uint8_t>(crc >> (24 - 8 * i)));
+}
+
+uint32_t PngWriter::crc32(const uint8_t* data, size_t length, uint32_t crc) {
+    static const struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[n] = c;
+            }
+        }
+    } table;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static const uint32_t adlerModulus = 65521;
+
+uint32_t PngWriter::adler32(const uint8_t* data, size_t length, uint32_t adler) {
+    // 5552 bytes is the longest run whose sums cannot overflow 32 bits before reducing
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (length > 0) {
+        size_t run = std::min<size_t>(length, 5552);
+        for (size_t i = 0; i < run; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= adlerModulus;
+        b %= adlerModulus;
+        data += run;
+        length -= run;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t PngWriter::adler32Combine(uint32_t first, uint32_t second, size_t secondLength) {
+    uint64_t remainder = secondLength % adlerModulus;
+    uint64_t a = (first & 0xFFFF) + (second & 0xFFFF) + adlerModulus - 1;
+    uint64_t b = remainder * (first & 0xFFFF) % adlerModulus + (first >> 16) + (second >> 16) + adlerModulus - remainder;
+    return static_cast<uint32_t>((b % adlerModulus) << 16 | (a % adlerModulus));
+}
+
+void PngWriter::appendChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* payload, size_t length) {
+    const uint8_t header[8] = {static_cast<uint8_t>(length >> 24), static_cast<uint8_t>(length >> 16),
+                               static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length),
+                               static_cast<uint8_t>(type[0]), static_cast<uint8_t>(type[1]),
+                               static_cast<uint8_t>(type[2]), static_cast<uint8_t>(type[3])};
+    uint32_t crc = crc32(header + 4, 4);
+    crc = crc32(payload, length, crc);
+    out.insert(out.end(), header, header + 8);
+    if (length > 0) out.insert(out.end(), payload, payload + length);
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(crc >> (24 - 8 * i)));
+}
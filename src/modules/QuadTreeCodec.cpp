@@ -0,0 +1,415 @@
+#include "../header/QuadTreeCodec.hpp"
+#include <fstream>
+#include <stdexcept>
+#include <cmath>
+#include <climits>
+
+std::vector<uint8_t> QuadTreeCodec::encode(const QuadTreeNode* root, int width, int height,
+                                           const std::vector<Pixel>& palette, int channels) {
+    if (palette.size() > 256) throw std::invalid_argument("Palette holds at most 256 entries");
+    uint8_t layout = layoutCode(channels);
+
+    std::vector<uint8_t> codes;
+    std::vector<uint32_t> cuts;
+    std::vector<const QuadTreeNode*> leaves;
+    bool explicitOffsets = false;
+    if (root) collect(root, codes, cuts, leaves, explicitOffsets);
+
+    bool binarySplits = false;
+    for (uint8_t code : codes) binarySplits = binarySplits || code == CUT_X || code == CUT_Y;
+    bool withPalette = !palette.empty();
+    bool withGradients = false;
+    for (const QuadTreeNode* leaf : leaves) withGradients = withGradients || leaf->hasGradient;
+
+    std::vector<uint8_t> out;
+    out.push_back('Q');
+    out.push_back('T');
+    out.push_back('C');
+    bool extended = binarySplits || withPalette || withGradients || layout != 0;
+    out.push_back(extended ? 2 : 1);
+    writeUint32(out, static_cast<uint32_t>(width));
+    writeUint32(out, static_cast<uint32_t>(height));
+    writeUint32(out, static_cast<uint32_t>(codes.size()));
+
+    if (!extended) {
+        // Structure bits, most significant bit first
+        size_t bitsStart = out.size();
+        out.resize(bitsStart + (codes.size() + 7) / 8, 0);
+        for (size_t i = 0; i < codes.size(); i++) {
+            if (codes[i] != LEAF) out[bitsStart + i / 8] |= static_cast<uint8_t>(0x80 >> (i % 8));
+        }
+    } else {
+        out.push_back((explicitOffsets ? EXPLICIT_OFFSETS : 0) | (withPalette ? PALETTE : 0) |
+                      (withGradients ? GRADIENTS : 0) | (layout << LAYOUT_SHIFT));
+        size_t codesStart = out.size();
+        out.resize(codesStart + (codes.size() + 3) / 4, 0);
+        for (size_t i = 0; i < codes.size(); i++) {
+            out[codesStart + i / 4] |= static_cast<uint8_t>(codes[i] << (6 - 2 * (i % 4)));
+        }
+        if (explicitOffsets) {
+            for (uint32_t cut : cuts) {
+                while (cut >= 0x80) {
+                    out.push_back(static_cast<uint8_t>(cut | 0x80));
+                    cut >>= 7;
+                }
+                out.push_back(static_cast<uint8_t>(cut));
+            }
+        }
+    }
+
+    if (!withPalette) {
+        for (const QuadTreeNode* leaf : leaves) {
+            size_t colorStart = out.size();
+            out.resize(colorStart + channels);
+            ChannelLayout::extract(leaf->averageColor, channels, &out[colorStart]);
+        }
+    } else {
+        writePaletteIndices(out, leaves, palette, channels);
+    }
+
+    if (withGradients) {
+        for (const QuadTreeNode* leaf : leaves) {
+            for (int c = 0; c < channels; c++) {
+                float slope = leaf->gradientX[ChannelLayout::component(channels, c)];
+                writeInt16(out, static_cast<int16_t>(std::lround(slope * 256.0f)));
+            }
+            for (int c = 0; c < channels; c++) {
+                float slope = leaf->gradientY[ChannelLayout::component(channels, c)];
+                writeInt16(out, static_cast<int16_t>(std::lround(slope * 256.0f)));
+            }
+        }
+    }
+
+    return out;
+}
+
+void QuadTreeCodec::writePaletteIndices(std::vector<uint8_t>& out, const std::vector<const QuadTreeNode*>& leaves,
+                                        const std::vector<Pixel>& palette, int channels) {
+    out.push_back(static_cast<uint8_t>(palette.size() - 1));
+    for (const Pixel& color : palette) {
+        size_t entryStart = out.size();
+        out.resize(entryStart + channels);
+        ChannelLayout::extract(color, channels, &out[entryStart]);
+    }
+
+    // Palette indices, most significant bit first
+    int indexBits = indexBitsFor(palette.size());
+    size_t indexStart = out.size();
+    out.resize(indexStart + (leaves.size() * indexBits + 7) / 8, 0);
+    size_t bit = 0;
+    for (const QuadTreeNode* leaf : leaves) {
+        if (leaf->paletteIndex < 0 || leaf->paletteIndex >= static_cast<int>(palette.size())) {
+            throw std::invalid_argument("Leaf has no valid palette index");
+        }
+        for (int b = indexBits - 1; b >= 0; b--, bit++) {
+            if ((leaf->paletteIndex >> b) & 1) out[indexStart + bit / 8] |= static_cast<uint8_t>(0x80 >> (bit % 8));
+        }
+    }
+}
+
+std::unique_ptr<QuadTreeNode> QuadTreeCodec::decode(const std::vector<uint8_t>& data, int& width, int& height) {
+    int channels;
+    return decode(data, width, height, channels);
+}
+
+std::unique_ptr<QuadTreeNode> QuadTreeCodec::decode(const std::vector<uint8_t>& data, int& width, int& height,
+                                                    int& channels) {
+    if (data.size() < headerSize || data[0] != 'Q' || data[1] != 'T' || data[2] != 'C' ||
+        (data[3] != 1 && data[3] != 2)) {
+        throw std::invalid_argument("Not an encoded quadtree");
+    }
+
+    const uint32_t storedWidth = readUint32(data, 4), storedHeight = readUint32(data, 8);
+    if (storedWidth > static_cast<uint32_t>(INT_MAX) || storedHeight > static_cast<uint32_t>(INT_MAX)) {
+        throw std::invalid_argument("Encoded quadtree size out of range");
+    }
+    width = static_cast<int>(storedWidth);
+    height = static_cast<int>(storedHeight);
+    Reader reader = {data, data[3], 3, false, readUint32(data, 12), headerSize, 0, 0, 0, {}, 0, 0, false, 0};
+    channels = 3;
+
+    size_t structureBytes;
+    uint8_t flags = 0;
+    if (reader.version == 1) {
+        structureBytes = (reader.nodeCount + 7) / 8;
+    } else {
+        if (data.size() <= headerSize) throw std::invalid_argument("Truncated quadtree structure");
+        flags = data[headerSize];
+        reader.explicitOffsets = flags & EXPLICIT_OFFSETS;
+        reader.channels = channels = layoutChannels((flags & LAYOUT_MASK) >> LAYOUT_SHIFT);
+        reader.codeStart = headerSize + 1;
+        structureBytes = (reader.nodeCount + 3) / 4;
+    }
+    if (reader.nodeCount == 0) return nullptr;
+    if (data.size() < reader.codeStart + structureBytes) throw std::invalid_argument("Truncated quadtree structure");
+
+    // Offsets follow the codes; colors follow the offsets, so find their start first
+    reader.offsetPos = reader.codeStart + structureBytes;
+    reader.colorPos = reader.offsetPos;
+    if (reader.explicitOffsets) {
+        for (size_t i = 0; i < reader.nodeCount; i++) {
+            uint8_t code = (data[reader.codeStart + i / 4] >> (6 - 2 * (i % 4))) & 3;
+            if (code == CUT_X || code == CUT_Y) readVarint(reader);
+        }
+        reader.colorPos = reader.offsetPos;
+        reader.offsetPos = reader.codeStart + structureBytes;
+    }
+
+    if (flags & PALETTE) {
+        if (reader.colorPos >= data.size()) throw std::invalid_argument("Truncated quadtree palette");
+        size_t paletteSize = static_cast<size_t>(data[reader.colorPos]) + 1;
+        size_t entries = reader.colorPos + 1;
+        if (entries + paletteSize * channels > data.size()) throw std::invalid_argument("Truncated quadtree palette");
+        for (size_t k = 0; k < paletteSize; k++) {
+            reader.palette.push_back(ChannelLayout::compose(&data[entries + channels * k], channels));
+        }
+        reader.indexBits = indexBitsFor(paletteSize);
+        reader.colorPos = entries + paletteSize * channels;
+    }
+
+    if (flags & GRADIENTS) {
+        // Gradients follow the leaf colors or palette indices
+        size_t leafCount = 0;
+        for (size_t i = 0; i < reader.nodeCount; i++) {
+            if (((data[reader.codeStart + i / 4] >> (6 - 2 * (i % 4))) & 3) == LEAF) leafCount++;
+        }
+        reader.gradients = true;
+        reader.gradientPos = reader.colorPos + (reader.palette.empty() ? leafCount * channels
+                                                                      : (leafCount * reader.indexBits + 7) / 8);
+        if (reader.gradientPos + leafCount * 4 * channels > data.size()) throw std::invalid_argument("Truncated quadtree gradients");
+    }
+
+    // Every split has at least two children, so at least half the nodes (rounded up) are leaves,
+    // each with a color or a palette index of its own, and no tree has more leaves than pixels
+    const size_t minLeaves = (reader.nodeCount + 1) / 2;
+    const size_t leafBytes = reader.palette.empty() ? minLeaves * reader.channels
+                                                    : (minLeaves * reader.indexBits + 7) / 8;
+    if (reader.colorPos + leafBytes > data.size() ||
+        minLeaves > static_cast<uint64_t>(width) * static_cast<uint64_t>(height)) {
+        throw std::invalid_argument("Quadtree node count does not match its data");
+    }
+
+    return rebuild(width, height, reader);
+}
+
+size_t QuadTreeCodec::encodedSize(int nodeCount, int leafCount, bool binarySplits, size_t offsetBytes,
+                                 int channels) {
+    size_t structure = binarySplits || channels != 3 ? 1 + (static_cast<size_t>(nodeCount) + 3) / 4
+                                                     : (static_cast<size_t>(nodeCount) + 7) / 8;
+    return headerSize + structure + offsetBytes + static_cast<size_t>(channels) * leafCount;
+}
+
+size_t QuadTreeCodec::encodedSize(const QuadTreeNode* root, const std::vector<Pixel>& palette, int channels) {
+    return encode(root, 0, 0, palette, channels).size();
+}
+
+size_t QuadTreeCodec::varintSize(uint32_t value) {
+    size_t bytes = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        bytes++;
+    }
+    return bytes;
+}
+
+bool QuadTreeCodec::saveToFile(const std::vector<uint8_t>& data, const std::string& filepath) {
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return static_cast<bool>(file);
+}
+
+bool QuadTreeCodec::loadFromFile(const std::string& filepath, std::vector<uint8_t>& data) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file) return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+QuadTreeCodec::NodeCode QuadTreeCodec::codeOf(const QuadTreeNode* node, int& cut) {
+    cut = 0;
+    if (node->isLeaf) return LEAF;
+    if (node->children[2]) return QUAD;
+    if (node->children[1]->x != node->children[0]->x) {
+        cut = node->children[0]->width;
+        return CUT_X;
+    }
+    cut = node->children[0]->height;
+    return CUT_Y;
+}
+
+void QuadTreeCodec::collect(const QuadTreeNode* node, std::vector<uint8_t>& codes, std::vector<uint32_t>& cuts,
+                            std::vector<const QuadTreeNode*>& leaves, bool& explicitOffsets) {
+    int cut;
+    NodeCode code = codeOf(node, cut);
+    codes.push_back(code);
+
+    if (code == LEAF) {
+        leaves.push_back(node);
+        return;
+    }
+    if (code == CUT_X || code == CUT_Y) {
+        cuts.push_back(static_cast<uint32_t>(cut));
+        int half = (code == CUT_X ? node->width : node->height) / 2;
+        explicitOffsets = explicitOffsets || cut != half;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i]) collect(node->children[i].get(), codes, cuts, leaves, explicitOffsets);
+    }
+}
+
+std::unique_ptr<QuadTreeNode> QuadTreeCodec::rebuild(int width, int height, Reader& reader) {
+    // Pre-order with an explicit stack of pending blocks, each with the slot its node goes into, so
+    // a crafted stream cannot exhaust the call stack; children are pushed in reverse
+    struct PendingBlock {
+        std::unique_ptr<QuadTreeNode>* slot;
+        BlockRect block;
+    };
+    const std::vector<uint8_t>& data = reader.data;
+    std::unique_ptr<QuadTreeNode> root;
+    std::vector<PendingBlock> pending;
+    pending.push_back(PendingBlock{&root, BlockRect{0, 0, width, height}});
+
+    while (!pending.empty()) {
+        PendingBlock current = pending.back();
+        pending.pop_back();
+        if (reader.nodeIndex >= reader.nodeCount) throw std::invalid_argument("Truncated quadtree structure");
+
+        size_t index = reader.nodeIndex++;
+        uint8_t code;
+        if (reader.version == 1) {
+            code = (data[reader.codeStart + index / 8] & (0x80 >> (index % 8))) ? QUAD : LEAF;
+        } else {
+            code = (data[reader.codeStart + index / 4] >> (6 - 2 * (index % 4))) & 3;
+        }
+
+        const int x = current.block.x, y = current.block.y;
+        const int blockWidth = current.block.width, blockHeight = current.block.height;
+        *current.slot = std::make_unique<QuadTreeNode>(x, y, blockWidth, blockHeight);
+        QuadTreeNode* node = current.slot->get();
+        if (code == LEAF) {
+            readLeaf(*node, reader);
+            continue;
+        }
+
+        BlockRect children[4];
+        int childCount;
+        if (code == QUAD) {
+            // Same quadrant geometry as QuadTreeCompressor::splitBlock, which never splits a block
+            // narrower or shorter than 2 pixels
+            if (blockWidth < 2 || blockHeight < 2) throw std::invalid_argument("Invalid quadtree split");
+            int halfWidth = blockWidth / 2;
+            int halfHeight = blockHeight / 2;
+            children[0] = BlockRect{x, y, halfWidth, halfHeight};
+            children[1] = BlockRect{x + halfWidth, y, blockWidth - halfWidth, halfHeight};
+            children[2] = BlockRect{x, y + halfHeight, halfWidth, blockHeight - halfHeight};
+            children[3] = BlockRect{x + halfWidth, y + halfHeight, blockWidth - halfWidth, blockHeight - halfHeight};
+            childCount = 4;
+        } else {
+            int length = code == CUT_X ? blockWidth : blockHeight;
+            if (length < 2) throw std::invalid_argument("Invalid quadtree split");
+            int cut = reader.explicitOffsets ? static_cast<int>(readVarint(reader)) : length / 2;
+            if (cut <= 0 || cut >= length) throw std::invalid_argument("Invalid quadtree cut offset");
+            if (code == CUT_X) {
+                children[0] = BlockRect{x, y, cut, blockHeight};
+                children[1] = BlockRect{x + cut, y, blockWidth - cut, blockHeight};
+            } else {
+                children[0] = BlockRect{x, y, blockWidth, cut};
+                children[1] = BlockRect{x, y + cut, blockWidth, blockHeight - cut};
+            }
+            childCount = 2;
+        }
+        for (int i = childCount - 1; i >= 0; i--) {
+            pending.push_back(PendingBlock{&node->children[i], children[i]});
+        }
+    }
+    return root;
+}
+
+void QuadTreeCodec::readLeaf(QuadTreeNode& node, Reader& reader) {
+    const std::vector<uint8_t>& data = reader.data;
+    node.isLeaf = true;
+    if (reader.gradients) {
+        node.hasGradient = true;
+        const int channels = reader.channels;
+        for (int c = 0; c < channels; c++) {
+            float slopeX = readInt16(data, reader.gradientPos + 2 * c) / 256.0f;
+            float slopeY = readInt16(data, reader.gradientPos + 2 * (channels + c)) / 256.0f;
+            // A gray sample drives r, g and b alike
+            int first = ChannelLayout::component(channels, c);
+            int last = (channels <= 2 && c == 0) ? 2 : first;
+            for (int k = first; k <= last; k++) {
+                node.gradientX[k] = slopeX;
+                node.gradientY[k] = slopeY;
+            }
+        }
+        reader.gradientPos += 4 * channels;
+    }
+    if (!reader.palette.empty()) {
+        int paletteIndex = 0;
+        for (int b = 0; b < reader.indexBits; b++, reader.indexBit++) {
+            size_t byte = reader.colorPos + reader.indexBit / 8;
+            if (byte >= data.size()) throw std::invalid_argument("Truncated quadtree palette indices");
+            paletteIndex = (paletteIndex << 1) | ((data[byte] >> (7 - reader.indexBit % 8)) & 1);
+        }
+        if (paletteIndex >= static_cast<int>(reader.palette.size())) throw std::invalid_argument("Invalid palette index");
+        node.paletteIndex = paletteIndex;
+        node.averageColor = reader.palette[paletteIndex];
+        return;
+    }
+    if (reader.colorPos + reader.channels > data.size()) throw std::invalid_argument("Truncated quadtree colors");
+    node.averageColor = ChannelLayout::compose(&data[reader.colorPos], reader.channels);
+    reader.colorPos += reader.channels;
+}
+
+int QuadTreeCodec::indexBitsFor(size_t paletteSize) {
+    int bits = 1;
+    while ((static_cast<size_t>(1) << bits) < paletteSize) bits++;
+    return bits;
+}
+
+uint8_t QuadTreeCodec::layoutCode(int channels) {
+    switch (channels) {
+        case 3: return 0;
+        case 1: return 1;
+        case 2: return 2;
+        case 4: return 3;
+        default: throw std::invalid_argument("Unsupported channel count");
+    }
+}
+
+int QuadTreeCodec::layoutChannels(uint8_t code) {
+    static const int channels[4] = {3, 1, 2, 4};
+    return channels[code & 3];
+}
+
+uint32_t QuadTreeCodec::readVarint(Reader& reader) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (reader.offsetPos >= reader.data.size()) throw std::invalid_argument("Truncated quadtree offsets");
+        uint8_t byte = reader.data[reader.offsetPos++];
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    throw std::invalid_argument("Invalid quadtree offset");
+}
+
+void QuadTreeCodec::writeUint32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void QuadTreeCodec::writeInt16(std::vector<uint8_t>& out, int16_t value) {
+    uint16_t bits = static_cast<uint16_t>(value);
+    out.push_back(static_cast<uint8_t>(bits));
+    out.push_back(static_cast<uint8_t>(bits >> 8));
+}
+
+int16_t QuadTreeCodec::readInt16(const std::vector<uint8_t>& data, size_t offset) {
+    return static_cast<int16_t>(data[offset] | (data[offset + 1] << 8));
+}
+
+uint32_t QuadTreeCodec::readUint32(const std::vector<uint8_t>& data, size_t offset) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value |= static_cast<uint32_t>(data[offset + i]) << (8 * i);
+    return value;
+}
@@ -0,0 +1,387 @@
+#include "../header/QuadTreeJpegEncoder.hpp"
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+// Zigzag position of each natural-order coefficient
+static const uint8_t zigZag[64] = {0, 1, 5, 6, 14, 15, 27, 28, 2, 4, 7, 13, 16, 26, 29, 42,
+                                   3, 8, 12, 17, 25, 30, 41, 43, 9, 11, 18, 24, 31, 40, 44, 53,
+                                   10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60,
+                                   21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63};
+
+// Example tables of the JPEG standard (Annex K)
+static const int lumaQuantization[64] = {16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+                                         14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+                                         18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+                                         49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+static const int chromaQuantization[64] = {17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+                                           24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+                                           99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+                                           99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+static const uint8_t dcLumaCounts[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t dcChromaCounts[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t dcValues[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t acLumaCounts[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t acLumaValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71,
+    0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37,
+    0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83,
+    0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+    0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+static const uint8_t acChromaCounts[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t acChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22,
+    0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+    0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36,
+    0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+    0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+    0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba,
+    0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+
+// AAN DCT output scales, times sqrt(8)
+static const float aanScale[8] = {1.0f * 2.828427125f, 1.387039845f * 2.828427125f, 1.306562965f * 2.828427125f,
+                                  1.175875602f * 2.828427125f, 1.0f * 2.828427125f, 0.785694958f * 2.828427125f,
+                                  0.541196100f * 2.828427125f, 0.275899379f * 2.828427125f};
+
+// Canonical Huffman codes from the per-length counts of a DHT segment
+struct HuffmanTable {
+    uint16_t code[256];
+    uint8_t length[256];
+
+    HuffmanTable(const uint8_t* counts, const uint8_t* values) : code(), length() {
+        uint16_t next = 0;
+        for (int bits = 1, k = 0; bits <= 16; bits++, next <<= 1) {
+            for (int i = 0; i < counts[bits - 1]; i++, k++, next++) {
+                code[values[k]] = next;
+                length[values[k]] = static_cast<uint8_t>(bits);
+            }
+        }
+    }
+};
+
+// Entropy-coded segment: bits from the top, a zero byte stuffed after every 0xFF
+class JpegBitWriter {
+public:
+    explicit JpegBitWriter(std::vector<uint8_t>& out) : out(out), buffer(0), count(0) {}
+
+    void put(uint32_t bits, int length) {
+        count += length;
+        buffer |= bits << (24 - count);
+        while (count >= 8) {
+            uint8_t byte = static_cast<uint8_t>(buffer >> 16);
+            out.push_back(byte);
+            if (byte == 0xFF) out.push_back(0);
+            buffer <<= 8;
+            count -= 8;
+        }
+    }
+
+    // Pads the last byte with one bits
+    void finish() { put(0x7F, 7); }
+
+private:
+    std::vector<uint8_t>& out;
+    uint32_t buffer;
+    int count;
+};
+
+// Quantization divisors in natural order and the Huffman tables of one component
+struct ComponentCoder {
+    float divisors[64];
+    const HuffmanTable& dc;
+    const HuffmanTable& ac;
+    int previousDC;
+
+    ComponentCoder(const uint8_t* zigZagTable, const HuffmanTable& dc, const HuffmanTable& ac)
+        : dc(dc), ac(ac), previousDC(0) {
+        for (int row = 0, k = 0; row < 8; row++) {
+            for (int col = 0; col < 8; col++, k++) {
+                divisors[k] = 1 / (zigZagTable[zigZag[k]] * aanScale[row] * aanScale[col]);
+            }
+        }
+    }
+};
+
+static void toYCbCr(const Pixel& p, float& y, float& cb, float& cr) {
+    float r = p.r, g = p.g, b = p.b;
+    y = +0.29900f * r + 0.58700f * g + 0.11400f * b - 128;
+    cb = -0.16874f * r - 0.33126f * g + 0.50000f * b;
+    cr = +0.50000f * r - 0.41869f * g - 0.08131f * b;
+}
+
+// One pass of the AAN float DCT over eight samples step apart
+static void dct(float* d, int step) {
+    float tmp0 = d[0] + d[7 * step], tmp7 = d[0] - d[7 * step];
+    float tmp1 = d[step] + d[6 * step], tmp6 = d[step] - d[6 * step];
+    float tmp2 = d[2 * step] + d[5 * step], tmp5 = d[2 * step] - d[5 * step];
+    float tmp3 = d[3 * step] + d[4 * step], tmp4 = d[3 * step] - d[4 * step];
+
+    float tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+    d[0] = tmp10 + tmp11;
+    d[4 * step] = tmp10 - tmp11;
+    float z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[2 * step] = tmp13 + z1;
+    d[6 * step] = tmp13 - z1;
+
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    float z5 = (tmp10 - tmp12) * 0.382683433f;
+    float z2 = tmp10 * 0.541196100f + z5;
+    float z4 = tmp12 * 1.306562965f + z5;
+    float z3 = tmp11 * 0.707106781f;
+    float z11 = tmp7 + z3, z13 = tmp7 - z3;
+    d[5 * step] = z13 + z2;
+    d[3 * step] = z13 - z2;
+    d[step] = z11 + z4;
+    d[7 * step] = z11 - z4;
+}
+
+static int quantize(float value) { return static_cast<int>(value < 0 ? value - 0.5f : value + 0.5f); }
+
+// Magnitude category and the value bits JPEG sends after it
+static void magnitudeOf(int value, uint32_t& bits, int& category) {
+    int magnitude = value < 0 ? -value : value;
+    category = 0;
+    while (magnitude) {
+        category++;
+        magnitude >>= 1;
+    }
+    bits = static_cast<uint32_t>(value < 0 ? value - 1 : value) & ((1u << category) - 1);
+}
+
+static void codeDC(JpegBitWriter& bits, ComponentCoder& coder, int dc) {
+    int diff = dc - coder.previousDC;
+    coder.previousDC = dc;
+    uint32_t value;
+    int category;
+    magnitudeOf(diff, value, category);
+    bits.put(coder.dc.code[category], coder.dc.length[category]);
+    if (category > 0) bits.put(value, category);
+}
+
+// Block of one flat value: the DCT leaves 64 * value in the DC term and zeros elsewhere
+static void codeFlatBlock(JpegBitWriter& bits, ComponentCoder& coder, float value) {
+    codeDC(bits, coder, quantize(value * 64 * coder.divisors[0]));
+    bits.put(coder.ac.code[0x00], coder.ac.length[0x00]);
+}
+
+static void codeBlock(JpegBitWriter& bits, ComponentCoder& coder, float* samples, int stride) {
+    for (int row = 0; row < 8; row++) dct(samples + row * stride, 1);
+    for (int col = 0; col < 8; col++) dct(samples + col, stride);
+    int coefficients[64];
+    for (int y = 0, k = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++, k++) coefficients[zigZag[k]] = quantize(samples[y * stride + x] * coder.divisors[k]);
+    }
+
+    codeDC(bits, coder, coefficients[0]);
+    int last = 63;
+    while (last > 0 && coefficients[last] == 0) last--;
+    for (int i = 1; i <= last; i++) {
+        int zeros = 0;
+        while (coefficients[i] == 0) {
+            zeros++;
+            i++;
+        }
+        for (; zeros >= 16; zeros -= 16) bits.put(coder.ac.code[0xF0], coder.ac.length[0xF0]);
+        uint32_t value;
+        int category;
+        magnitudeOf(coefficients[i], value, category);
+        int symbol = (zeros << 4) + category;
+        bits.put(coder.ac.code[symbol], coder.ac.length[symbol]);
+        bits.put(value, category);
+    }
+    if (last != 63) bits.put(coder.ac.code[0x00], coder.ac.length[0x00]);
+}
+
+QuadTreeJpegEncoder::QuadTreeJpegEncoder(const QuadTreeNode* root, int quality)
+    : root(root), quality(quality), blockCount(0), flatBlockCount(0) {
+    if (!root) throw std::invalid_argument("Empty tree");
+    if (root->width > 65535 || root->height > 65535) throw std::invalid_argument("Image too large for JPEG");
+    if (quality < 1 || quality > 100) throw std::invalid_argument("JPEG quality must be between 1 and 100");
+}
+
+size_t QuadTreeJpegEncoder::getBlockCount() const { return blockCount; }
+size_t QuadTreeJpegEncoder::getFlatBlockCount() const { return flatBlockCount; }
+
+bool QuadTreeJpegEncoder::write(const std::string& filepath) const {
+    std::vector<uint8_t> jpeg = encode();
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char*>(jpeg.data()), jpeg.size());
+    return static_cast<bool>(file);
+}
+
+std::vector<uint8_t> QuadTreeJpegEncoder::encode() const {
+    const int width = root->width, height = root->height;
+    const bool subsample = quality <= 90;
+    const int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    uint8_t lumaTable[64], chromaTable[64];
+    for (int i = 0; i < 64; i++) {
+        lumaTable[zigZag[i]] = static_cast<uint8_t>(std::min(std::max((lumaQuantization[i] * scale + 50) / 100, 1), 255));
+        chromaTable[zigZag[i]] = static_cast<uint8_t>(std::min(std::max((chromaQuantization[i] * scale + 50) / 100, 1), 255));
+    }
+
+    std::vector<uint8_t> out;
+    const uint8_t start[] = {0xFF, 0xD8, 0xFF, 0xE0, 0, 0x10, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0,
+                             0xFF, 0xDB, 0, 0x84, 0};
+    out.insert(out.end(), start, start + sizeof(start));
+    out.insert(out.end(), lumaTable, lumaTable + 64);
+    out.push_back(1);
+    out.insert(out.end(), chromaTable, chromaTable + 64);
+    const uint8_t frame[] = {0xFF, 0xC0, 0, 0x11, 8, static_cast<uint8_t>(height >> 8), static_cast<uint8_t>(height),
+                             static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(width), 3,
+                             1, static_cast<uint8_t>(subsample ? 0x22 : 0x11), 0, 2, 0x11, 1, 3, 0x11, 1,
+                             0xFF, 0xC4, 0x01, 0xA2};
+    out.insert(out.end(), frame, frame + sizeof(frame));
+    const std::pair<const uint8_t*, const uint8_t*> huffman[4] = {
+        {dcLumaCounts, dcValues}, {acLumaCounts, acLumaValues}, {dcChromaCounts, dcValues}, {acChromaCounts, acChromaValues}};
+    const uint8_t classes[4] = {0x00, 0x10, 0x01, 0x11};
+    for (int t = 0; t < 4; t++) {
+        out.push_back(classes[t]);
+        out.insert(out.end(), huffman[t].first, huffman[t].first + 16);
+        int symbols = 0;
+        for (int i = 0; i < 16; i++) symbols += huffman[t].first[i];
+        out.insert(out.end(), huffman[t].second, huffman[t].second + symbols);
+    }
+    const uint8_t scan[] = {0xFF, 0xDA, 0, 0xC, 3, 1, 0, 2, 0x11, 3, 0x11, 0, 0x3F, 0};
+    out.insert(out.end(), scan, scan + sizeof(scan));
+
+    static const HuffmanTable dcLuma(dcLumaCounts, dcValues), acLuma(acLumaCounts, acLumaValues);
+    static const HuffmanTable dcChroma(dcChromaCounts, dcValues), acChroma(acChromaCounts, acChromaValues);
+    ComponentCoder luma(lumaTable, dcLuma, acLuma), blue(chromaTable, dcChroma, acChroma), red(chromaTable, dcChroma, acChroma);
+    JpegBitWriter bits(out);
+    blockCount = flatBlockCount = 0;
+
+    const int mcuSize = subsample ? 16 : 8;
+    const int blockRows = mcuSize / 8;
+    const int blocksAcross = (width + mcuSize - 1) / mcuSize * blockRows;
+    std::vector<const QuadTreeNode*> flat[2];
+    std::vector<Pixel> strip(static_cast<size_t>(width) * mcuSize);
+    float Y[256], U[256], V[256];
+
+    for (int y = 0; y < height; y += mcuSize) {
+        for (int r = 0; r < blockRows; r++) {
+            flat[r].assign(blocksAcross, nullptr);
+            findFlatBlocks(root, std::min(y + 8 * r, height - 1), std::min(y + 8 * r + 8, height), width, flat[r]);
+        }
+        bool stripFilled = false;
+
+        for (int x = 0; x < width; x += mcuSize) {
+            const int column = x / 8;
+            bool mcuFlat = true;
+            for (int r = 0; r < blockRows; r++) {
+                for (int c = 0; c < blockRows; c++) mcuFlat = mcuFlat && flat[r][column + c] == flat[0][column];
+            }
+            mcuFlat = mcuFlat && flat[0][column];
+            blockCount += blockRows * blockRows + 2;
+
+            if (!mcuFlat) {
+                if (!stripFilled) {
+                    fillStrip(root, y, std::min(y + mcuSize, height), width, strip);
+                    stripFilled = true;
+                }
+                // Samples past the image repeat its last row and column
+                // and runs of one color, as the leaves give, are converted once
+                for (int row = 0, pos = 0; row < mcuSize; row++) {
+                    const Pixel* source = &strip[static_cast<size_t>(std::min(y + row, height - 1) - y) * width];
+                    for (int col = 0; col < mcuSize; col++, pos++) {
+                        const Pixel& pixel = source[std::min(x + col, width - 1)];
+                        if (col > 0 && pixel == source[std::min(x + col - 1, width - 1)]) {
+                            Y[pos] = Y[pos - 1];
+                            U[pos] = U[pos - 1];
+                            V[pos] = V[pos - 1];
+                        } else {
+                            toYCbCr(pixel, Y[pos], U[pos], V[pos]);
+                        }
+                    }
+                }
+            }
+
+            for (int r = 0; r < blockRows; r++) {
+                for (int c = 0; c < blockRows; c++) {
+                    if (const QuadTreeNode* leaf = flat[r][column + c]) {
+                        float y0, cb, cr;
+                        toYCbCr(leaf->averageColor, y0, cb, cr);
+                        codeFlatBlock(bits, luma, y0);
+                        flatBlockCount++;
+                    } else {
+                        codeBlock(bits, luma, Y + r * 8 * mcuSize + c * 8, mcuSize);
+                    }
+                }
+            }
+            if (mcuFlat) {
+                float y0, cb, cr;
+                toYCbCr(flat[0][column]->averageColor, y0, cb, cr);
+                codeFlatBlock(bits, blue, cb);
+                codeFlatBlock(bits, red, cr);
+                flatBlockCount += 2;
+            } else if (subsample) {
+                float subU[64], subV[64];
+                for (int row = 0, pos = 0; row < 8; row++) {
+                    for (int col = 0; col < 8; col++, pos++) {
+                        int j = row * 32 + col * 2;
+                        subU[pos] = (U[j] + U[j + 1] + U[j + 16] + U[j + 17]) * 0.25f;
+                        subV[pos] = (V[j] + V[j + 1] + V[j + 16] + V[j + 17]) * 0.25f;
+                    }
+                }
+                codeBlock(bits, blue, subU, 8);
+                codeBlock(bits, red, subV, 8);
+            } else {
+                codeBlock(bits, blue, U, 8);
+                codeBlock(bits, red, V, 8);
+            }
+        }
+    }
+
+    bits.finish();
+    out.push_back(0xFF);
+    out.push_back(0xD9);
+    return out;
+}
+
+void QuadTreeJpegEncoder::findFlatBlocks(const QuadTreeNode* node, int top, int bottom, int width,
+                                         std::vector<const QuadTreeNode*>& flat) {
+    // Only nodes spanning all the rows can hold a leaf that does
+    if (node->y > top || node->y + node->height < bottom) return;
+    if (!node->isLeaf) {
+        for (int i = 0; i < 4; i++) {
+            if (node->children[i]) findFlatBlocks(node->children[i].get(), top, bottom, width, flat);
+        }
+        return;
+    }
+    if (node->hasGradient) return;
+
+    int right = node->x + node->width;
+    int last = right == width ? static_cast<int>(flat.size()) - 1 : std::min((right - 1) / 8, static_cast<int>(flat.size()) - 1);
+    for (int c = node->x / 8; c <= last; c++) {
+        int blockLeft = std::min(8 * c, width - 1), blockRight = std::min(8 * c + 8, width);
+        if (blockLeft >= node->x && blockRight <= right) flat[c] = node;
+    }
+}
+
+void QuadTreeJpegEncoder::fillStrip(const QuadTreeNode* node, int top, int bottom, int width, std::vector<Pixel>& strip) {
+    if (node->y >= bottom || node->y + node->height <= top) return;
+    if (!node->isLeaf) {
+        for (int i = 0; i < 4; i++) {
+            if (node->children[i]) fillStrip(node->children[i].get(), top, bottom, width, strip);
+        }
+        return;
+    }
+    for (int y = std::max(top, node->y); y < std::min(bottom, node->y + node->height); y++) {
+        Pixel* row = &strip[static_cast<size_t>(y - top) * width];
+        if (!node->hasGradient) {
+            std::fill(row + node->x, row + node->x + node->width, node->averageColor);
+            continue;
+        }
+        for (int x = node->x; x < node->x + node->width; x++) row[x] = node->colorAt(x, y);
+    }
+}
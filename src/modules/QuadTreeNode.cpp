@@ -1,111 +1,422 @@
 #include "../header/QuadTreeNode.hpp"
+#include "../header/PaletteQuantizer.hpp"
+#include "../header/MetricTreeBuilder.hpp"
+#include "../header/Parallel.hpp"
 
 QuadTreeCompressor::QuadTreeCompressor(ImagePixel& image, ErrorCalculator::ErrorMethod method, double threshold, int minBlockSize)
     : image(image), method(method), 
-      threshold(threshold), minBlockSize(minBlockSize),
-      treeDepth(0), nodeCount(0) {}
+      threshold(threshold), minBlockSize(std::max(minBlockSize, 1)),
+      splitPolicy(QUAD_SPLIT), leafModel(FLAT_MODEL), buildStrategy(PYRAMID_BUILD), partitioned(false), pyramid(nullptr), treeDepth(0), nodeCount(0) {}
+
+QuadTreeCompressor::QuadTreeCompressor(ImagePixel& image, const StatisticsPyramid& pyramid, ErrorCalculator::ErrorMethod method, double threshold, int minBlockSize)
+    : image(image), method(method),
+      threshold(threshold), minBlockSize(std::max(minBlockSize, 1)),
+      splitPolicy(QUAD_SPLIT), leafModel(FLAT_MODEL), buildStrategy(PYRAMID_BUILD), partitioned(false), pyramid(&pyramid), treeDepth(0), nodeCount(0) {}
+
+void QuadTreeCompressor::setSplitPolicy(SplitPolicy policy) { splitPolicy = policy; }
+void QuadTreeCompressor::setLeafModel(LeafModel model) { leafModel = model; }
+void QuadTreeCompressor::setBuildStrategy(BuildStrategy strategy) { buildStrategy = strategy; }
+void QuadTreeCompressor::setPartitioned(bool partitioned) { this->partitioned = partitioned; }
 
 void QuadTreeCompressor::compress() {
     if (root) {
         root.reset();
+        palette.clear();
         treeDepth = 0;
         nodeCount = 0;
     }
     
-    root = buildQuadTree(0, 0, image.getWidth(), image.getHeight(), 1);
+    // The fused builder covers the built-in flat metrics with quad splits; others use the pyramid
+    bool fused = buildStrategy == FUSED_BUILD || buildStrategy == BOUNDED_BUILD;
+    if (fused && splitPolicy == QUAD_SPLIT && leafModel == FLAT_MODEL) {
+        // Bounded scans re-read every leaf, which costs MAD and entropy more than their weaker
+        // histogram bounds save, so those two keep the plain fused scans
+        bool bounded = buildStrategy == BOUNDED_BUILD && !ErrorCalculator::requiresHistogram(method);
+        switch (method) {
+            case ErrorCalculator::VARIANCE: compressWith<VarianceMetric>(bounded); return;
+            case ErrorCalculator::MEAN_ABSOLUTE_DEVIATION: compressWith<MeanAbsoluteDeviationMetric>(bounded); return;
+            case ErrorCalculator::MAX_PIXEL_DIFFERENCE: compressWith<MaxDifferenceMetric>(bounded); return;
+            case ErrorCalculator::ENTROPY: compressWith<EntropyMetric>(bounded); return;
+            case ErrorCalculator::SSIM: compressWith<SSIMMetric>(bounded); return;
+            default: break;
+        }
+    }
+    
+    if (!pyramid) {
+        ownedPyramid = std::make_unique<StatisticsPyramid>(image, ErrorCalculator::requiresHistogram(method));
+        pyramid = ownedPyramid.get();
+    }
+    
+    bool needsMoments = leafModel == PLANE_MODEL || method == ErrorCalculator::PLANE_RESIDUAL;
+    if (needsMoments && !moments) moments = std::make_unique<MomentImage>(image);
+    
+    root = buildStrategy == LEVEL_BUILD ? buildLevels() : buildQuadTree(0, 0, image.getWidth(), image.getHeight(), 1);
 }
 
-void QuadTreeCompressor::reconstruct(ImagePixel& outputImage) {
+void QuadTreeCompressor::applyPalette(int paletteSize) {
+    if (paletteSize < 2 || paletteSize > 256) throw std::invalid_argument("Palette size must be in 2-256");
+    if (!root) return;
+    
+    std::vector<QuadTreeNode*> leaves;
+    collectLeaves(root.get(), leaves);
+    
+    // Leaves are weighted by area so large flat regions keep their exact color
+    std::vector<Pixel> colors;
+    std::vector<uint64_t> weights;
+    colors.reserve(leaves.size());
+    weights.reserve(leaves.size());
+    for (const QuadTreeNode* leaf : leaves) {
+        colors.push_back(leaf->averageColor);
+        weights.push_back(static_cast<uint64_t>(leaf->width) * leaf->height);
+    }
+    
+    std::vector<int> assignment;
+    palette = PaletteQuantizer::build(colors, weights, paletteSize, assignment);
+    
+    // A fused build leaves no pyramid behind, so the leaf errors below need one built here
+    if (!pyramid) {
+        ownedPyramid = std::make_unique<StatisticsPyramid>(image, ErrorCalculator::requiresHistogram(method));
+        pyramid = ownedPyramid.get();
+    }
+    
+    for (size_t i = 0; i < leaves.size(); i++) {
+        QuadTreeNode* leaf = leaves[i];
+        leaf->paletteIndex = assignment[i];
+        leaf->averageColor = palette[assignment[i]];
+        pyramid->query(leaf->x, leaf->y, leaf->width, leaf->height, blockStats, false);
+        if (leaf->hasGradient) {
+            PlaneFit fit = moments->fit(leaf->x, leaf->y, leaf->width, leaf->height, blockStats);
+            leaf->squaredError = squaredErrorAgainst(fit, *leaf);
+        } else {
+            leaf->squaredError = squaredErrorAgainst(blockStats, leaf->averageColor);
+        }
+    }
+}
+
+const std::vector<Pixel>& QuadTreeCompressor::getPalette() const { return palette; }
+
+void QuadTreeCompressor::reconstruct(ImagePixel& outputImage) const {
     if (!root) return;
     
-    std::vector<std::vector<Pixel>> matrix(image.getHeight(), 
-                                         std::vector<Pixel>(image.getWidth()));
-    reconstructImage(root.get(), matrix);
-    outputImage.createFromMatrix(matrix);
+    outputImage.create(image.getWidth(), image.getHeight(), image.getChannels());
+    reconstructImage(root.get(), outputImage);
 }
 
 int QuadTreeCompressor::getTreeDepth() const { return treeDepth; }
 int QuadTreeCompressor::getNodeCount() const { return nodeCount; }
+const QuadTreeNode* QuadTreeCompressor::getRoot() const { return root.get(); }
+
+bool QuadTreeCompressor::canSplit(int width, int height, int minBlockSize) {
+    // Blocks are at least one pixel across, whatever the requested minimum
+    minBlockSize = std::max(minBlockSize, 1);
+    return (width > minBlockSize && height > minBlockSize) &&
+           (width/2 >= minBlockSize && height/2 >= minBlockSize);
+}
+
+bool QuadTreeCompressor::childrenFit(const QuadTreeNode* node, int minBlockSize) {
+    for (int i = 0; i < 4; i++) {
+        const QuadTreeNode* child = node->children[i].get();
+        if (child && (child->width < minBlockSize || child->height < minBlockSize)) return false;
+    }
+    return true;
+}
 
 std::unique_ptr<QuadTreeNode> QuadTreeCompressor::buildQuadTree(int x, int y, int width, int height, int currentDepth) {
-    auto node = std::make_unique<QuadTreeNode>(x, y, width, height);
-    nodeCount++;
-    treeDepth = std::max(treeDepth, currentDepth);
-    
-    // Get the current block
-    std::vector<std::vector<Pixel>> block;
-    getBlock(image, x, y, width, height, block);
-    
-    // Calculate error and mean values
-    double rMean, gMean, bMean;
-    double error = ErrorCalculator::calculateError(method, block, rMean, gMean, bMean);
-    
-    // Check if we should split
-    bool shouldSplit = (error > threshold) && 
-                      (width > minBlockSize && height > minBlockSize) &&
-                      (width/2 >= minBlockSize && height/2 >= minBlockSize);
-    
-    if (shouldSplit) {
-        // Split into 4 quadrants
-        int halfWidth = width / 2;
-        int halfHeight = height / 2;
+    // Depth first with an explicit stack of pending blocks, each with the slot its node goes into;
+    // children are pushed in reverse so nodes are built in the same order as a recursive walk
+    struct PendingBlock {
+        std::unique_ptr<QuadTreeNode>* slot;
+        BlockRect block;
+        int depth;
+    };
+    std::unique_ptr<QuadTreeNode> root;
+    std::vector<PendingBlock> pending;
+    pending.push_back(PendingBlock{&root, BlockRect{x, y, width, height}, currentDepth});
+    
+    while (!pending.empty()) {
+        PendingBlock current = pending.back();
+        pending.pop_back();
+        const BlockRect& block = current.block;
+        *current.slot = std::make_unique<QuadTreeNode>(block.x, block.y, block.width, block.height);
+        QuadTreeNode* node = current.slot->get();
+        nodeCount++;
+        treeDepth = std::max(treeDepth, current.depth);
+        evaluateNode(*node, blockStats);
         
-        // Top-left
-        node->children[0] = buildQuadTree(x, y, halfWidth, halfHeight, currentDepth + 1);
-        // Top-right
-        node->children[1] = buildQuadTree(x + halfWidth, y, width - halfWidth, halfHeight, currentDepth + 1);
-        // Bottom-left
-        node->children[2] = buildQuadTree(x, y + halfHeight, halfWidth, height - halfHeight, currentDepth + 1);
-        // Bottom-right
-        node->children[3] = buildQuadTree(x + halfWidth, y + halfHeight, 
-                                         width - halfWidth, height - halfHeight, currentDepth + 1);
-    } else {
-        // Leaf node - store average color
-        node->isLeaf = true;
-        node->averageColor = Pixel(static_cast<uint8_t>(rMean),
-                                 static_cast<uint8_t>(gMean),
-                                 static_cast<uint8_t>(bMean));
+        // Split when the block is not uniform enough and the policy finds a valid cut
+        BlockRect childBlocks[4];
+        int childCount = (node->error > threshold) ? splitBlock(block, childBlocks, candidateStats) : 0;
+        if (childCount == 0) {
+            node->isLeaf = true;
+            continue;
+        }
+        for (int i = childCount - 1; i >= 0; i--) {
+            pending.push_back(PendingBlock{&node->children[i], childBlocks[i], current.depth + 1});
+        }
     }
     
-    return node;
+    return root;
 }
 
-void QuadTreeCompressor::reconstructImage(QuadTreeNode* node, std::vector<std::vector<Pixel>>& matrix) {
-    if (!node) return;
+std::unique_ptr<QuadTreeNode> QuadTreeCompressor::buildLevels() {
+    // One level's blocks as parallel arrays, with the slot each block's node goes into
+    struct Frontier {
+        std::vector<int> x, y, width, height;
+        std::vector<std::unique_ptr<QuadTreeNode>*> slot;
+        
+        size_t size() const { return slot.size(); }
+        void push(const BlockRect& block, std::unique_ptr<QuadTreeNode>* target) {
+            x.push_back(block.x);
+            y.push_back(block.y);
+            width.push_back(block.width);
+            height.push_back(block.height);
+            slot.push_back(target);
+        }
+        void clear() {
+            x.clear();
+            y.clear();
+            width.clear();
+            height.clear();
+            slot.clear();
+        }
+    };
+    // Below this many blocks per worker a level is cheaper to evaluate on one thread
+    const int blocksPerWorker = 256;
     
-    if (node->isLeaf) {
-        // Fill the block with average color
-        for (int y = node->y; y < node->y + node->height; y++) {
-            for (int x = node->x; x < node->x + node->width; x++) {
-                if (static_cast<size_t>(y) < matrix.size() && static_cast<size_t>(x) < matrix[y].size()){
-                    matrix[y][x] = node->averageColor;
-                }
+    std::unique_ptr<QuadTreeNode> root;
+    Frontier frontier, next;
+    std::vector<int> childCounts;
+    std::vector<BlockRect> childBlocks;
+    frontier.push(BlockRect{0, 0, image.getWidth(), image.getHeight()}, &root);
+    
+    for (int depth = 1; frontier.size() > 0; depth++) {
+        const int count = static_cast<int>(frontier.size());
+        childCounts.assign(count, 0);
+        childBlocks.resize(static_cast<size_t>(count) * 4);
+        
+        // Each block is evaluated and cut on its own, so the chunks share nothing but the pyramid
+        int workers = Parallel::workerCount((count + blocksPerWorker - 1) / blocksPerWorker);
+        Parallel::forChunks(0, count, workers, [&](int begin, int end, int) {
+            BlockStatistics stats;
+            BlockStatistics scratch;
+            for (int i = begin; i < end; i++) {
+                auto node = std::make_unique<QuadTreeNode>(frontier.x[i], frontier.y[i], frontier.width[i], frontier.height[i]);
+                evaluateNode(*node, stats);
+                BlockRect block = {frontier.x[i], frontier.y[i], frontier.width[i], frontier.height[i]};
+                childCounts[i] = node->error > threshold ? splitBlock(block, &childBlocks[static_cast<size_t>(i) * 4], scratch) : 0;
+                node->isLeaf = childCounts[i] == 0;
+                *frontier.slot[i] = std::move(node);
+            }
+        });
+        
+        // Compaction keeps frontier order, so the nodes and counts match the depth-first build
+        nodeCount += count;
+        treeDepth = depth;
+        next.clear();
+        for (int i = 0; i < count; i++) {
+            QuadTreeNode* node = frontier.slot[i]->get();
+            for (int k = 0; k < childCounts[i]; k++) {
+                next.push(childBlocks[static_cast<size_t>(i) * 4 + k], &node->children[k]);
             }
         }
+        std::swap(frontier, next);
+    }
+    
+    return root;
+}
+
+void QuadTreeCompressor::evaluateNode(QuadTreeNode& node, BlockStatistics& stats) const {
+    const int x = node.x, y = node.y, width = node.width, height = node.height;
+    
+    // Gather the block statistics from the pyramid
+    pyramid->query(x, y, width, height, stats, ErrorCalculator::requiresHistogram(method));
+    
+    // Calculate error and mean values; the plane fit comes from the moment images
+    const int channels = stats.channels;
+    double values[ChannelLayout::maxChannels];
+    uint8_t samples[ChannelLayout::maxChannels];
+    PlaneFit fit = {};
+    if (moments) fit = moments->fit(x, y, width, height, stats);
+    double error = method == ErrorCalculator::PLANE_RESIDUAL
+                 ? ErrorCalculator::calculatePlaneResidual(fit, values)
+                 : ErrorCalculator::calculateError(method, stats, values);
+    
+    // Every node keeps its color and error so the tree can be re-cut later (see ThresholdSweep)
+    node.error = error;
+    for (int c = 0; c < channels; c++) samples[c] = static_cast<uint8_t>(values[c]);
+    node.averageColor = ChannelLayout::compose(samples, channels);
+    if (leafModel == PLANE_MODEL) {
+        // Plane leaves round their base color, since rendering rounds the plane around it
+        node.hasGradient = true;
+        for (int c = 0; c < channels; c++) {
+            samples[c] = static_cast<uint8_t>(std::min(255.0, std::round(fit.mean[c])));
+            // A gray sample drives r, g and b alike
+            int first = ChannelLayout::component(channels, c);
+            int last = (channels <= 2 && c == 0) ? 2 : first;
+            for (int k = first; k <= last; k++) {
+                node.gradientX[k] = quantizeGradient(fit.gradientX[c]);
+                node.gradientY[k] = quantizeGradient(fit.gradientY[c]);
+            }
+        }
+        node.averageColor = ChannelLayout::compose(samples, channels);
+        node.squaredError = squaredErrorAgainst(fit, node);
     } else {
-        // Reconstruct children
-        for (int i = 0; i < 4; i++) {
-            reconstructImage(node->children[i].get(), matrix);
+        node.squaredError = squaredErrorAgainst(stats, node.averageColor);
+    }
+}
+
+int QuadTreeCompressor::splitBlock(const BlockRect& block, BlockRect children[4], BlockStatistics& stats) const {
+    const int x = block.x, y = block.y, width = block.width, height = block.height;
+    
+    switch (splitPolicy) {
+        case QUAD_SPLIT: {
+            if (!canSplit(width, height, minBlockSize)) return 0;
+            int halfWidth = width / 2;
+            int halfHeight = height / 2;
+            // Top-left, top-right, bottom-left, bottom-right
+            children[0] = BlockRect{x, y, halfWidth, halfHeight};
+            children[1] = BlockRect{x + halfWidth, y, width - halfWidth, halfHeight};
+            children[2] = BlockRect{x, y + halfHeight, halfWidth, height - halfHeight};
+            children[3] = BlockRect{x + halfWidth, y + halfHeight, width - halfWidth, height - halfHeight};
+            return 4;
         }
+        case LONGER_AXIS_SPLIT: {
+            if (width >= height) {
+                int half = width / 2;
+                if (half < minBlockSize || height < minBlockSize) return 0;
+                children[0] = BlockRect{x, y, half, height};
+                children[1] = BlockRect{x + half, y, width - half, height};
+            } else {
+                int half = height / 2;
+                if (half < minBlockSize || width < minBlockSize) return 0;
+                children[0] = BlockRect{x, y, width, half};
+                children[1] = BlockRect{x, y + half, width, height - half};
+            }
+            return 2;
+        }
+        case BEST_SPLIT:
+            return splitBest(block, children, stats);
+        default:
+            throw std::invalid_argument("Invalid split policy");
     }
 }
 
-void QuadTreeCompressor::getBlock(const ImagePixel& img, int x, int y, int width, int height,
-             std::vector<std::vector<Pixel>>& block) {
-    block.clear();
-    block.reserve(height);
+int QuadTreeCompressor::splitBest(const BlockRect& block, BlockRect children[4], BlockStatistics& stats) const {
+    // Candidate cuts at every eighth of each axis, scored by the children's total squared error
+    const int candidates = 8;
+    double bestCost = 0.0;
+    int found = 0;
     
-    for (int row = y; row < y + height; row++) {
-        if (row >= img.getHeight()) break;
-        
-        std::vector<Pixel> rowPixels;
-        rowPixels.reserve(width);
+    for (int axis = 0; axis < 2; axis++) {
+        int length = axis == 0 ? block.width : block.height;
+        int across = axis == 0 ? block.height : block.width;
+        if (across < minBlockSize) continue;
         
-        for (int col = x; col < x + width; col++) {
-            if (col >= img.getWidth()) break;
-            rowPixels.push_back(img.getPixel(col, row));
+        int previous = 0;
+        for (int k = 1; k < candidates; k++) {
+            int cut = length * k / candidates;
+            if (cut == previous || cut < minBlockSize || length - cut < minBlockSize) continue;
+            previous = cut;
+            
+            BlockRect first = axis == 0 ? BlockRect{block.x, block.y, cut, block.height}
+                                        : BlockRect{block.x, block.y, block.width, cut};
+            BlockRect second = axis == 0 ? BlockRect{block.x + cut, block.y, block.width - cut, block.height}
+                                         : BlockRect{block.x, block.y + cut, block.width, block.height - cut};
+            double cost = squaredErrorOf(first, stats) + squaredErrorOf(second, stats);
+            if (found == 0 || cost < bestCost) {
+                bestCost = cost;
+                children[0] = first;
+                children[1] = second;
+                found = 2;
+            }
+        }
+    }
+    
+    return found;
+}
+
+double QuadTreeCompressor::squaredErrorOf(const BlockRect& block, BlockStatistics& stats) const {
+    pyramid->query(block.x, block.y, block.width, block.height, stats, false);
+    if (stats.count == 0) return 0.0;
+    
+    ExactSum deviation = 0;
+    for (int c = 0; c < stats.channels; c++) deviation += scaledSquaredDeviation(stats, c);
+    return static_cast<double>(deviation) / stats.count;
+}
+
+void QuadTreeCompressor::reconstructImage(QuadTreeNode* node, ImagePixel& outputImage) const {
+    if (!node) return;
+    
+    const int width = outputImage.getWidth(), height = outputImage.getHeight();
+    std::vector<const QuadTreeNode*> pending(1, node);
+    while (!pending.empty()) {
+        const QuadTreeNode* current = pending.back();
+        pending.pop_back();
+        if (!current->isLeaf) {
+            for (int i = 3; i >= 0; i--) {
+                if (current->children[i]) pending.push_back(current->children[i].get());
+            }
+            continue;
         }
         
-        block.push_back(rowPixels);
+        // Fill the block with its leaf model, clipped to the image; flat leaves fill whole row spans
+        int bottom = std::min(current->y + current->height, height);
+        int left = std::max(current->x, 0);
+        int right = std::min(current->x + current->width, width);
+        if (left >= right) continue;
+        for (int y = std::max(current->y, 0); y < bottom; y++) {
+            if (!current->hasGradient) {
+                outputImage.fillSpan(y, left, right, current->averageColor);
+                continue;
+            }
+            for (int x = left; x < right; x++) outputImage.setPixel(x, y, current->colorAt(x, y));
+        }
+    }
+}
+
+double QuadTreeCompressor::squaredErrorAgainst(const BlockStatistics& stats, const Pixel& color) {
+    uint8_t values[ChannelLayout::maxChannels];
+    ChannelLayout::extract(color, stats.channels, values);
+    uint64_t total = 0;
+    for (int c = 0; c < stats.channels; c++) total += squaredErrorAround(stats, c, values[c]);
+    return static_cast<double>(total);
+}
+
+double QuadTreeCompressor::squaredErrorAgainst(const PlaneFit& fit, const QuadTreeNode& node) {
+    // Plane residual plus the (orthogonal) cost of the stored color and quantized gradients;
+    // rounding of the rendered pixels is not included
+    uint8_t values[ChannelLayout::maxChannels];
+    ChannelLayout::extract(node.averageColor, fit.channels, values);
+    double total = 0.0;
+    for (int c = 0; c < fit.channels; c++) {
+        int component = ChannelLayout::component(fit.channels, c);
+        double meanOffset = fit.mean[c] - values[c];
+        double slopeX = fit.gradientX[c] - node.gradientX[component];
+        double slopeY = fit.gradientY[c] - node.gradientY[component];
+        total += fit.residual[c] + fit.count * meanOffset * meanOffset
+               + slopeX * slopeX * fit.sumXX + slopeY * slopeY * fit.sumYY;
+    }
+    return total;
+}
+
+float QuadTreeCompressor::quantizeGradient(double gradient) {
+    // Stored by the codec as int16 in steps of 1/256 per pixel
+    double steps = std::round(gradient * 256.0);
+    steps = std::max(-32768.0, std::min(32767.0, steps));
+    return static_cast<float>(steps / 256.0);
+}
+
+void QuadTreeCompressor::collectLeaves(QuadTreeNode* node, std::vector<QuadTreeNode*>& leaves) {
+    std::vector<QuadTreeNode*> pending(1, node);
+    while (!pending.empty()) {
+        QuadTreeNode* current = pending.back();
+        pending.pop_back();
+        if (current->isLeaf) {
+            leaves.push_back(current);
+            continue;
+        }
+        for (int i = 3; i >= 0; i--) {
+            if (current->children[i]) pending.push_back(current->children[i].get());
+        }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,82 @@
+#include "../header/QuadTreePngEncoder.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+QuadTreePngEncoder::QuadTreePngEncoder(const QuadTreeNode* root, int channels)
+    : root(root), channels(channels), level(PngWriter::FAST_LEVEL), stripes(0) {
+    if (!root) throw std::invalid_argument("Empty tree");
+    if (channels < 1 || channels > ChannelLayout::maxChannels) {
+        throw std::invalid_argument("Unsupported channel count");
+    }
+}
+
+void QuadTreePngEncoder::setLevel(PngWriter::Level level) { this->level = level; }
+
+void QuadTreePngEncoder::setStripes(int stripes) {
+    if (stripes < 0) throw std::invalid_argument("Stripe count cannot be negative");
+    this->stripes = stripes;
+}
+
+std::vector<uint8_t> QuadTreePngEncoder::encode() const {
+    std::vector<uint8_t> rowChanges;
+    return makeWriter(rowChanges).encode(rowSource());
+}
+
+bool QuadTreePngEncoder::write(const std::string& filepath) const {
+    std::vector<uint8_t> rowChanges;
+    return makeWriter(rowChanges).write(filepath, rowSource());
+}
+
+PngWriter QuadTreePngEncoder::makeWriter(std::vector<uint8_t>& rowChanges) const {
+    rowChanges.assign(root->height, 0);
+    markRowChanges(root, root->y, rowChanges);
+
+    PngWriter writer(root->width, root->height, channels);
+    writer.setLevel(level);
+    writer.setStripes(stripes);
+    PngWriter::RowFilter changedRow = level == PngWriter::DEFAULT_LEVEL ? PngWriter::ADAPTIVE_FILTER
+                                                                        : PngWriter::UP_FILTER;
+    writer.setFilterSource([&rowChanges, changedRow](int y) {
+        return rowChanges[y] ? changedRow : PngWriter::REPEATED_ROW;
+    });
+    return writer;
+}
+
+PngWriter::RowSource QuadTreePngEncoder::rowSource() const {
+    return [this](int y, uint8_t* row) {
+        ChannelLayout::dispatch(channels, [&](auto layout) {
+            fillRow<decltype(layout)::value>(root, root->y + y, root->x, row);
+        });
+    };
+}
+
+void QuadTreePngEncoder::markRowChanges(const QuadTreeNode* node, int top, std::vector<uint8_t>& rowChanges) {
+    if (node->isLeaf) {
+        int last = node->hasGradient ? node->y + node->height : node->y + 1;
+        std::fill(rowChanges.begin() + (node->y - top), rowChanges.begin() + (last - top), 1);
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i]) markRowChanges(node->children[i].get(), top, rowChanges);
+    }
+}
+
+template <int C>
+void QuadTreePngEncoder::fillRow(const QuadTreeNode* node, int y, int left, uint8_t* row) {
+    if (y < node->y || y >= node->y + node->height) return;
+    if (!node->isLeaf) {
+        for (int i = 0; i < 4; i++) {
+            if (node->children[i]) fillRow<C>(node->children[i].get(), y, left, row);
+        }
+        return;
+    }
+
+    uint8_t* out = row + static_cast<size_t>(node->x - left) * C;
+    if (node->hasGradient) {
+        for (int i = 0; i < node->width; i++) ChannelLayout::extract<C>(node->colorAt(node->x + i, y), out + i * C);
+        return;
+    }
+    uint8_t samples[ChannelLayout::maxChannels];
+    ChannelLayout::extract<C>(node->averageColor, samples);
+    for (int i = 0; i < node->width; i++) std::copy(samples, samples + C, out + i * C);
+}
@@ -0,0 +1,71 @@
+#include "../header/QuadTreeQuery.hpp"
+#include "../header/QuadTreeRenderer.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+QuadTreeQuery::QuadTreeQuery(const QuadTreeNode* root, int channels) : root(root), channels(channels) {
+    if (channels < 1 || channels > ChannelLayout::maxChannels) {
+        throw std::invalid_argument("Unsupported channel count");
+    }
+}
+
+const QuadTreeNode* QuadTreeQuery::leafAt(int x, int y) const {
+    const QuadTreeNode* node = root;
+    if (!node || !contains(node, x, y)) return nullptr;
+    while (!node->isLeaf) {
+        const QuadTreeNode* next = nullptr;
+        for (int i = 0; i < 4 && !next; i++) {
+            if (node->children[i] && contains(node->children[i].get(), x, y)) next = node->children[i].get();
+        }
+        if (!next) return nullptr;
+        node = next;
+    }
+    return node;
+}
+
+Pixel QuadTreeQuery::colorAt(int x, int y) const {
+    const QuadTreeNode* leaf = leafAt(x, y);
+    if (!leaf) throw std::out_of_range("Pixel coordinates out of range");
+    return leaf->colorAt(x, y);
+}
+
+void QuadTreeQuery::leavesInRect(const BlockRect& rect, std::vector<const QuadTreeNode*>& leaves) const {
+    leaves.clear();
+    if (root) collectLeaves(root, rect, leaves);
+}
+
+void QuadTreeQuery::renderViewport(const BlockRect& viewport, int zoom, ImagePixel& outputImage) const {
+    if (zoom < 1) throw std::invalid_argument("Zoom must be at least 1");
+    if (!root) throw std::invalid_argument("Empty tree");
+
+    BlockRect clipped;
+    clipped.x = std::max(viewport.x, root->x);
+    clipped.y = std::max(viewport.y, root->y);
+    clipped.width = std::min(viewport.x + viewport.width, root->x + root->width) - clipped.x;
+    clipped.height = std::min(viewport.y + viewport.height, root->y + root->height) - clipped.y;
+    if (clipped.width <= 0 || clipped.height <= 0) throw std::invalid_argument("Viewport lies outside the image");
+
+    QuadTreeRenderer(root, channels).render(clipped, (clipped.width + zoom - 1) / zoom,
+                                            (clipped.height + zoom - 1) / zoom, outputImage);
+}
+
+bool QuadTreeQuery::intersects(const QuadTreeNode* node, const BlockRect& rect) {
+    return node->x < rect.x + rect.width && rect.x < node->x + node->width &&
+           node->y < rect.y + rect.height && rect.y < node->y + node->height;
+}
+
+bool QuadTreeQuery::contains(const QuadTreeNode* node, int x, int y) {
+    return x >= node->x && x < node->x + node->width && y >= node->y && y < node->y + node->height;
+}
+
+void QuadTreeQuery::collectLeaves(const QuadTreeNode* node, const BlockRect& rect,
+                                  std::vector<const QuadTreeNode*>& leaves) const {
+    if (!intersects(node, rect)) return;
+    if (node->isLeaf) {
+        leaves.push_back(node);
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i]) collectLeaves(node->children[i].get(), rect, leaves);
+    }
+}
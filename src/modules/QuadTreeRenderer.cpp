@@ -0,0 +1,67 @@
+#include "../header/QuadTreeRenderer.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+QuadTreeRenderer::QuadTreeRenderer(const QuadTreeNode* root, int channels) : root(root), channels(channels) {
+    if (channels < 1 || channels > ChannelLayout::maxChannels) {
+        throw std::invalid_argument("Unsupported channel count");
+    }
+}
+
+void QuadTreeRenderer::render(int outputWidth, int outputHeight, ImagePixel& outputImage) const {
+    if (!root) throw std::invalid_argument("Empty tree");
+    render(BlockRect{root->x, root->y, root->width, root->height}, outputWidth, outputHeight, outputImage);
+}
+
+void QuadTreeRenderer::render(const BlockRect& region, int outputWidth, int outputHeight, ImagePixel& outputImage) const {
+    if (!root) throw std::invalid_argument("Empty tree");
+    if (outputWidth < 1 || outputHeight < 1) throw std::invalid_argument("Output size must be positive");
+
+    BlockRect clipped;
+    clipped.x = std::max(region.x, root->x);
+    clipped.y = std::max(region.y, root->y);
+    clipped.width = std::min(region.x + region.width, root->x + root->width) - clipped.x;
+    clipped.height = std::min(region.y + region.height, root->y + root->height) - clipped.y;
+    if (clipped.width <= 0 || clipped.height <= 0) throw std::invalid_argument("Region lies outside the image");
+
+    outputImage.create(outputWidth, outputHeight, channels);
+    renderNode(root, Axis{clipped.x, clipped.width, outputWidth}, Axis{clipped.y, clipped.height, outputHeight}, outputImage);
+}
+
+// Center of output index i sits at origin + (2i + 1) * length / (2 * size); integer math keeps
+// neighbouring nodes from claiming the same output pixel
+int QuadTreeRenderer::Axis::firstAt(int edge) const {
+    int64_t scaled = 2 * static_cast<int64_t>(edge - origin) * size;
+    if (scaled <= 0) return 0;
+    int64_t odd = (scaled + length - 1) / length;  // smallest 2i + 1 reaching the edge
+    return static_cast<int>(std::min<int64_t>(odd / 2, size));
+}
+
+int QuadTreeRenderer::Axis::sourceOf(int index) const {
+    return origin + static_cast<int>((2 * static_cast<int64_t>(index) + 1) * length / (2 * static_cast<int64_t>(size)));
+}
+
+void QuadTreeRenderer::renderNode(const QuadTreeNode* node, const Axis& axisX, const Axis& axisY,
+                                  ImagePixel& outputImage) const {
+    int firstX = axisX.firstAt(node->x), lastX = axisX.firstAt(node->x + node->width);
+    int firstY = axisY.firstAt(node->y), lastY = axisY.firstAt(node->y + node->height);
+    if (firstX >= lastX || firstY >= lastY) return;
+
+    bool belowPixel = static_cast<int64_t>(node->width) * axisX.size < axisX.length &&
+                      static_cast<int64_t>(node->height) * axisY.size < axisY.length;
+    if (!node->isLeaf && !belowPixel) {
+        for (int i = 0; i < 4; i++) {
+            if (node->children[i]) renderNode(node->children[i].get(), axisX, axisY, outputImage);
+        }
+        return;
+    }
+
+    for (int j = firstY; j < lastY; j++) {
+        if (!node->hasGradient) {
+            outputImage.fillSpan(j, firstX, lastX, node->averageColor);
+            continue;
+        }
+        int sourceY = axisY.sourceOf(j);
+        for (int i = firstX; i < lastX; i++) outputImage.setPixel(i, j, node->colorAt(axisX.sourceOf(i), sourceY));
+    }
+}
@@ -0,0 +1,165 @@
+#include "../header/QuadTreeSvgWriter.hpp"
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+QuadTreeSvgWriter::QuadTreeSvgWriter(const QuadTreeNode* root, int channels)
+    : root(root), channels(channels), shapeCount(0) {
+    if (!root) throw std::invalid_argument("Empty tree");
+    if (channels < 1 || channels > ChannelLayout::maxChannels) {
+        throw std::invalid_argument("Unsupported channel count");
+    }
+}
+
+size_t QuadTreeSvgWriter::getShapeCount() const { return shapeCount; }
+
+bool QuadTreeSvgWriter::saveToFile(const std::string& filepath) const {
+    std::ofstream file(filepath);
+    if (!file) return false;
+    write(file);
+    return static_cast<bool>(file);
+}
+
+void QuadTreeSvgWriter::write(std::ostream& out) const {
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << root->width << "\" height=\"" << root->height
+        << "\" viewBox=\"" << root->x << " " << root->y << " " << root->width << " " << root->height
+        << "\" shape-rendering=\"crispEdges\">\n";
+    Stream stream{out, false, Rect{0, 0, 0, 0, Pixel()}, 0, 0};
+    Pixel color;
+    if (visit(root, stream, color)) emitRect(Rect{root->x, root->y, root->width, root->height, color}, stream);
+    flush(stream);
+    out << "</svg>\n";
+    shapeCount = stream.shapes;
+}
+
+bool QuadTreeSvgWriter::visit(const QuadTreeNode* node, Stream& stream, Pixel& color) const {
+    if (node->isLeaf) {
+        if (node->hasGradient) {
+            writeGradientLeaf(node, stream);
+            return false;
+        }
+        color = node->averageColor;
+        return true;
+    }
+
+    const QuadTreeNode* children[4];
+    Pixel colors[4];
+    bool flat[4];
+    int count = 0;
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i]) children[count++] = node->children[i].get();
+    }
+    bool uniform = true;
+    for (int i = 0; i < count; i++) {
+        flat[i] = visit(children[i], stream, colors[i]);
+        uniform = uniform && flat[i] && colors[i] == colors[0];
+    }
+    if (uniform) {
+        color = colors[0];
+        return true;
+    }
+
+    // Halves of a quad node that share a color go out as one rect: the rows first, then the columns
+    bool emitted[4] = {false, false, false, false};
+    if (count == 4) {
+        static const int halves[4][2] = {{0, 1}, {2, 3}, {0, 2}, {1, 3}};
+        for (const auto& half : halves) {
+            int a = half[0], b = half[1];
+            if (emitted[a] || emitted[b] || !flat[a] || !flat[b] || colors[a] != colors[b]) continue;
+            int right = std::max(children[a]->x + children[a]->width, children[b]->x + children[b]->width);
+            int bottom = std::max(children[a]->y + children[a]->height, children[b]->y + children[b]->height);
+            emitRect(Rect{children[a]->x, children[a]->y, right - children[a]->x, bottom - children[a]->y, colors[a]}, stream);
+            emitted[a] = emitted[b] = true;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (flat[i] && !emitted[i]) {
+            emitRect(Rect{children[i]->x, children[i]->y, children[i]->width, children[i]->height, colors[i]}, stream);
+        }
+    }
+    return false;
+}
+
+void QuadTreeSvgWriter::emitRect(const Rect& rect, Stream& stream) const {
+    Rect& pending = stream.rect;
+    if (stream.pending && pending.color == rect.color) {
+        if (pending.y == rect.y && pending.height == rect.height &&
+            (pending.x + pending.width == rect.x || rect.x + rect.width == pending.x)) {
+            pending.x = std::min(pending.x, rect.x);
+            pending.width += rect.width;
+            return;
+        }
+        if (pending.x == rect.x && pending.width == rect.width &&
+            (pending.y + pending.height == rect.y || rect.y + rect.height == pending.y)) {
+            pending.y = std::min(pending.y, rect.y);
+            pending.height += rect.height;
+            return;
+        }
+    }
+    flush(stream);
+    pending = rect;
+    stream.pending = true;
+}
+
+void QuadTreeSvgWriter::flush(Stream& stream) const {
+    if (!stream.pending) return;
+    const Rect& rect = stream.rect;
+    stream.out << "<rect x=\"" << rect.x << "\" y=\"" << rect.y << "\" width=\"" << rect.width
+               << "\" height=\"" << rect.height << "\"";
+    writePaint(rect.color, "fill", "fill-opacity", stream.out);
+    stream.out << "/>\n";
+    stream.pending = false;
+    stream.shapes++;
+}
+
+void QuadTreeSvgWriter::writeGradientLeaf(const QuadTreeNode* node, Stream& stream) const {
+    flush(stream);
+    // Steepest direction of the luma plane; the stops are the leaf colors where it leaves the block
+    float slopeX = 0.299f * node->gradientX[0] + 0.587f * node->gradientX[1] + 0.114f * node->gradientX[2];
+    float slopeY = 0.299f * node->gradientY[0] + 0.587f * node->gradientY[1] + 0.114f * node->gradientY[2];
+    float length = std::sqrt(slopeX * slopeX + slopeY * slopeY);
+    float unitX = length > 0.0f ? slopeX / length : 1.0f, unitY = length > 0.0f ? slopeY / length : 0.0f;
+    float reach = 0.5f * (std::fabs(unitX) * (node->width - 1) + std::fabs(unitY) * (node->height - 1));
+    float centerX = node->x + node->width * 0.5f, centerY = node->y + node->height * 0.5f;
+
+    Pixel stops[2];
+    for (int s = 0; s < 2; s++) {
+        float dx = (s ? reach : -reach) * unitX, dy = (s ? reach : -reach) * unitY;
+        uint8_t values[4];
+        for (int c = 0; c < 4; c++) {
+            float v = std::floor(node->averageColor[c] + 0.5f + node->gradientX[c] * dx + node->gradientY[c] * dy);
+            values[c] = static_cast<uint8_t>(std::min(std::max(v, 0.0f), 255.0f));
+        }
+        stops[s] = Pixel(values[0], values[1], values[2], values[3]);
+    }
+
+    std::ostream& out = stream.out;
+    size_t id = stream.gradients++;
+    out << "<defs><linearGradient id=\"g" << id << "\" gradientUnits=\"userSpaceOnUse\" x1=\""
+        << centerX - reach * unitX << "\" y1=\"" << centerY - reach * unitY << "\" x2=\""
+        << centerX + reach * unitX << "\" y2=\"" << centerY + reach * unitY << "\">";
+    for (int s = 0; s < 2; s++) {
+        out << "<stop offset=\"" << s << "\"";
+        writePaint(stops[s], "stop-color", "stop-opacity", out);
+        out << "/>";
+    }
+    out << "</linearGradient></defs>\n<rect x=\"" << node->x << "\" y=\"" << node->y << "\" width=\""
+        << node->width << "\" height=\"" << node->height << "\" fill=\"url(#g" << id << ")\"/>\n";
+    stream.shapes++;
+}
+
+void QuadTreeSvgWriter::writePaint(const Pixel& color, const char* colorAttribute, const char* opacityAttribute,
+                                   std::ostream& out) const {
+    static const char digits[] = "0123456789abcdef";
+    const uint8_t components[3] = {color.r, color.g, color.b};
+    char hex[8] = {'#'};
+    for (int i = 0; i < 3; i++) {
+        hex[1 + 2 * i] = digits[components[i] >> 4];
+        hex[2 + 2 * i] = digits[components[i] & 15];
+    }
+    out << " " << colorAttribute << "=\"" << hex << "\"";
+    if ((channels == 2 || channels == 4) && color.a < 255) {
+        out << " " << opacityAttribute << "=\"" << color.a / 255.0f << "\"";
+    }
+}
@@ -0,0 +1,123 @@
+#include "../header/QualityMetrics.hpp"
+#include "../header/QuadTreeCodec.hpp"
+#include "../header/Parallel.hpp"
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+QualityReport QualityMetrics::compare(const ImagePixel& original, const ImagePixel& reconstructed) {
+    if (original.getWidth() != reconstructed.getWidth() || original.getHeight() != reconstructed.getHeight()) {
+        throw std::invalid_argument("Images must have the same dimensions");
+    }
+    if (original.getChannels() != reconstructed.getChannels()) {
+        throw std::invalid_argument("Images must have the same channel count");
+    }
+
+    QualityReport report = {0.0, std::numeric_limits<double>::infinity(), 1.0};
+    const int height = original.getHeight();
+    const int channels = original.getChannels();
+    const double count = static_cast<double>(original.getWidth()) * height;
+    if (count == 0) return report;
+
+    // One partial per chunk of rows, merged in chunk order
+    const int rowsPerChunk = 64;
+    int chunks = Parallel::fixedChunks(height, rowsPerChunk);
+    std::vector<ChannelSums> partials(static_cast<size_t>(chunks) * channels, ChannelSums{0, 0, 0, 0, 0, 0});
+    Parallel::forChunks(0, height, chunks, [&](int rowBegin, int rowEnd, int chunk) {
+        ChannelLayout::dispatch(channels, [&](auto layout) {
+            accumulateRows<decltype(layout)::value>(original, reconstructed, rowBegin, rowEnd,
+                                                    &partials[static_cast<size_t>(chunk) * channels]);
+        });
+    });
+
+    ChannelSums total[ChannelLayout::maxChannels] = {};
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        for (int c = 0; c < channels; c++) {
+            const ChannelSums& part = partials[static_cast<size_t>(chunk) * channels + c];
+            total[c].sumX += part.sumX;
+            total[c].sumY += part.sumY;
+            total[c].sumXX += part.sumXX;
+            total[c].sumYY += part.sumYY;
+            total[c].sumXY += part.sumXY;
+            total[c].sumDiff += part.sumDiff;
+        }
+    }
+
+    // Global (single window) SSIM per channel, averaged over the layout's channels
+    const double c1 = (0.01 * 255.0) * (0.01 * 255.0);
+    const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+    double squaredError = 0.0, ssim = 0.0;
+    for (int c = 0; c < channels; c++) {
+        double meanX = total[c].sumX / count;
+        double meanY = total[c].sumY / count;
+        double varX = total[c].sumXX / count - meanX * meanX;
+        double varY = total[c].sumYY / count - meanY * meanY;
+        double covariance = total[c].sumXY / count - meanX * meanY;
+        ssim += ((2.0 * meanX * meanY + c1) * (2.0 * covariance + c2)) /
+                ((meanX * meanX + meanY * meanY + c1) * (varX + varY + c2));
+        squaredError += static_cast<double>(total[c].sumDiff);
+    }
+
+    report.mse = squaredError / (channels * count);
+    report.psnr = psnrFromMSE(report.mse);
+    report.ssim = ssim / channels;
+    return report;
+}
+
+template <int C>
+void QualityMetrics::accumulateRows(const ImagePixel& original, const ImagePixel& reconstructed,
+                                    int rowBegin, int rowEnd, ChannelSums sums[C]) {
+    const int width = original.getWidth();
+
+    for (int y = rowBegin; y < rowEnd; y++) {
+        const uint8_t* rowA = original.getRow(y);
+        const uint8_t* rowB = reconstructed.getRow(y);
+        // Plain integer reductions over the row, which the compiler vectorizes
+        uint64_t sumX[C] = {}, sumY[C] = {}, sumXX[C] = {}, sumYY[C] = {}, sumXY[C] = {}, sumDiff[C] = {};
+        for (int x = 0; x < width; x++) {
+            const uint8_t* sx = rowA + x * C;
+            const uint8_t* sy = rowB + x * C;
+            for (int c = 0; c < C; c++) {
+                const uint32_t vx = sx[c], vy = sy[c];
+                int32_t diff = static_cast<int32_t>(vx) - static_cast<int32_t>(vy);
+                sumX[c] += vx;
+                sumY[c] += vy;
+                sumXX[c] += vx * vx;
+                sumYY[c] += vy * vy;
+                sumXY[c] += vx * vy;
+                sumDiff[c] += static_cast<uint32_t>(diff * diff);
+            }
+        }
+        for (int c = 0; c < C; c++) {
+            sums[c].sumX += sumX[c];
+            sums[c].sumY += sumY[c];
+            sums[c].sumXX += sumXX[c];
+            sums[c].sumYY += sumYY[c];
+            sums[c].sumXY += sumXY[c];
+            sums[c].sumDiff += sumDiff[c];
+        }
+    }
+}
+
+double QualityMetrics::analyticMSE(const QuadTreeNode* root, int width, int height, int channels) {
+    if (!root || width <= 0 || height <= 0) return 0.0;
+    return leafSquaredError(root) / (static_cast<double>(channels) * width * height);
+}
+
+double QualityMetrics::psnrFromMSE(double mse) {
+    if (mse <= 0.0) return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+size_t QualityMetrics::encodedSize(const QuadTreeNode* root, const std::vector<Pixel>& palette, int channels) {
+    return QuadTreeCodec::encodedSize(root, palette, channels);
+}
+
+double QualityMetrics::leafSquaredError(const QuadTreeNode* node) {
+    if (node->isLeaf) return node->squaredError;
+    double total = 0.0;
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i]) total += leafSquaredError(node->children[i].get());
+    }
+    return total;
+}
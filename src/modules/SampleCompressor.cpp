@@ -0,0 +1,197 @@
+#include "../header/SampleCompressor.hpp"
+#include "../header/QuadTreeNode.hpp"
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+template <typename T>
+SampleCompressor<T>::SampleCompressor(const SampleImage<T>& image, ErrorCalculator::ErrorMethod method,
+                                      double threshold, int minBlockSize)
+    : image(image), method(method), threshold(threshold), minBlockSize(minBlockSize), treeDepth(0), nodeCount(0) {
+    if (method == ErrorCalculator::PLANE_RESIDUAL) {
+        throw std::invalid_argument("Plane residual is only available for 8-bit images");
+    }
+    if (method < ErrorCalculator::VARIANCE || method > ErrorCalculator::PLANE_RESIDUAL) {
+        throw std::invalid_argument("Registered and combined metrics are only available for 8-bit images");
+    }
+}
+
+template <typename T>
+void SampleCompressor<T>::compress() {
+    root.reset();
+    treeDepth = 0;
+    nodeCount = 0;
+    if (usesHistogram()) histogram.assign(static_cast<size_t>(Traits::histogramBins) * image.getChannels(), 0);
+    root = buildQuadTree(0, 0, image.getWidth(), image.getHeight(), 1);
+}
+
+template <typename T>
+void SampleCompressor<T>::reconstruct(SampleImage<T>& outputImage) const {
+    outputImage.create(image.getWidth(), image.getHeight(), image.getChannels());
+    if (root) reconstructNode(root.get(), outputImage);
+}
+
+template <typename T> int SampleCompressor<T>::getTreeDepth() const { return treeDepth; }
+template <typename T> int SampleCompressor<T>::getNodeCount() const { return nodeCount; }
+template <typename T> const SampleNode<T>* SampleCompressor<T>::getRoot() const { return root.get(); }
+
+template <typename T>
+std::unique_ptr<SampleNode<T>> SampleCompressor<T>::buildQuadTree(int x, int y, int width, int height, int currentDepth) {
+    auto node = std::make_unique<SampleNode<T>>(x, y, width, height);
+    nodeCount++;
+    treeDepth = std::max(treeDepth, currentDepth);
+
+    node->error = evaluateBlock(*node, node->value);
+
+    // Same quadrant geometry as QuadTreeCompressor
+    if (node->error > threshold && QuadTreeCompressor::canSplit(width, height, minBlockSize)) {
+        int halfWidth = width / 2;
+        int halfHeight = height / 2;
+        node->children[0] = buildQuadTree(x, y, halfWidth, halfHeight, currentDepth + 1);
+        node->children[1] = buildQuadTree(x + halfWidth, y, width - halfWidth, halfHeight, currentDepth + 1);
+        node->children[2] = buildQuadTree(x, y + halfHeight, halfWidth, height - halfHeight, currentDepth + 1);
+        node->children[3] = buildQuadTree(x + halfWidth, y + halfHeight, width - halfWidth, height - halfHeight, currentDepth + 1);
+    } else {
+        node->isLeaf = true;
+    }
+    return node;
+}
+
+template <typename T>
+double SampleCompressor<T>::evaluateBlock(const SampleNode<T>& node, T* values) {
+    const int channels = image.getChannels();
+    const uint64_t count = static_cast<uint64_t>(node.width) * node.height;
+    if (count == 0) return 0.0;
+
+    Moments moments[ChannelLayout::maxChannels];
+    T minValue[ChannelLayout::maxChannels], maxValue[ChannelLayout::maxChannels];
+    for (int c = 0; c < channels; c++) {
+        minValue[c] = std::numeric_limits<T>::max();
+        maxValue[c] = std::numeric_limits<T>::lowest();
+    }
+    // One scan gathers the moments, ranges and, when the metric needs them, the histograms
+    const bool binned = usesHistogram();
+    auto scan = [&](auto withHistogram) {
+        for (int y = node.y; y < node.y + node.height; y++) {
+            const T* row = image.row(y) + static_cast<size_t>(node.x) * channels;
+            for (int i = 0; i < node.width * channels; i += channels) {
+                for (int c = 0; c < channels; c++) {
+                    moments[c].add(row[i + c]);
+                    minValue[c] = std::min(minValue[c], row[i + c]);
+                    maxValue[c] = std::max(maxValue[c], row[i + c]);
+                    if constexpr (decltype(withHistogram)::value) {
+                        int bin = Traits::bin(row[i + c]);
+                        if (histogram[static_cast<size_t>(bin) * channels + c]++ == 0) touchedBins[c].push_back(bin);
+                    }
+                }
+            }
+        }
+    };
+    if (binned) scan(std::true_type());
+    else scan(std::false_type());
+
+    double means[ChannelLayout::maxChannels];
+    for (int c = 0; c < channels; c++) {
+        means[c] = moments[c].mean(count);
+        values[c] = Traits::fromMean(means[c]);
+    }
+
+    double total = 0.0;
+    switch (method) {
+        case ErrorCalculator::VARIANCE:
+            for (int c = 0; c < channels; c++) total += moments[c].variance(count);
+            return total / (channels * SampleScale<T>::maxVariance());
+        case ErrorCalculator::MEAN_ABSOLUTE_DEVIATION: {
+            // Deviations from the now known means, in a second scan
+            double deviation[ChannelLayout::maxChannels] = {};
+            for (int y = node.y; y < node.y + node.height; y++) {
+                const T* row = image.row(y) + static_cast<size_t>(node.x) * channels;
+                for (int i = 0; i < node.width * channels; i += channels) {
+                    for (int c = 0; c < channels; c++) deviation[c] += std::fabs(row[i + c] - means[c]);
+                }
+            }
+            for (int c = 0; c < channels; c++) total += deviation[c] / count;
+            return total / (channels * SampleScale<T>::maxMAD());
+        }
+        case ErrorCalculator::MAX_PIXEL_DIFFERENCE:
+            for (int c = 0; c < channels; c++) {
+                values[c] = Traits::fromMean((static_cast<double>(maxValue[c]) + minValue[c]) / 2.0);
+                total += static_cast<double>(maxValue[c]) - minValue[c];
+            }
+            return total / (channels * SampleScale<T>::maxDiff());
+        case ErrorCalculator::ENTROPY:
+            for (int c = 0; c < channels; c++) total += channelEntropy(c, count);
+            return total / (channels * SampleScale<T>::maxEntropy());
+        case ErrorCalculator::SSIM: {
+            const double c2 = (0.03 * Traits::maxValue) * (0.03 * Traits::maxValue);
+            for (int c = 0; c < channels; c++) total += c2 / (moments[c].variance(count) + c2);
+            return 1.0 - total / channels;
+        }
+        default:
+            throw std::invalid_argument("Invalid error method");
+    }
+}
+
+template <typename T>
+bool SampleCompressor<T>::usesHistogram() const {
+    // MAD scans the block a second time instead: filling and walking 65536 bins costs 16-bit
+    // samples more, and float samples do not fall on exact bins
+    return method == ErrorCalculator::ENTROPY;
+}
+
+template <typename T>
+double SampleCompressor<T>::channelEntropy(int channel, uint64_t count) {
+    const int channels = image.getChannels();
+    double entropy = 0.0;
+    for (int bin : touchedBins[channel]) {
+        uint32_t& frequency = histogram[static_cast<size_t>(bin) * channels + channel];
+        double prob = frequency / static_cast<double>(count);
+        entropy -= prob * std::log2(prob);
+        frequency = 0;
+    }
+    touchedBins[channel].clear();
+    return entropy;
+}
+
+template <typename T>
+void SampleCompressor<T>::reconstructNode(const SampleNode<T>* node, SampleImage<T>& outputImage) const {
+    if (!node->isLeaf) {
+        for (int i = 0; i < 4; i++) {
+            if (node->children[i]) reconstructNode(node->children[i].get(), outputImage);
+        }
+        return;
+    }
+    const int channels = image.getChannels();
+    for (int y = node->y; y < node->y + node->height; y++) {
+        T* row = outputImage.row(y) + static_cast<size_t>(node->x) * channels;
+        for (int i = 0; i < node->width * channels; i += channels) {
+            for (int c = 0; c < channels; c++) row[i + c] = node->value[c];
+        }
+    }
+}
+
+template <typename T>
+double SampleCompressor<T>::meanSquaredError(const SampleImage<T>& original, const SampleImage<T>& reconstructed) {
+    if (original.getSamples().size() != reconstructed.getSamples().size()) {
+        throw std::invalid_argument("Images must have the same dimensions");
+    }
+    const std::vector<T>& a = original.getSamples();
+    const std::vector<T>& b = reconstructed.getSamples();
+    if (a.empty()) return 0.0;
+
+    CompensatedSum squaredError;
+    for (size_t i = 0; i < a.size(); i++) {
+        double difference = static_cast<double>(a[i]) - b[i];
+        squaredError.add(difference * difference);
+    }
+    return squaredError.value() / a.size();
+}
+
+template <typename T>
+double SampleCompressor<T>::psnrFromMSE(double mse) {
+    if (mse <= 0.0) return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(Traits::maxValue * Traits::maxValue / mse);
+}
+
+template class SampleCompressor<uint16_t>;
+template class SampleCompressor<float>;
@@ -0,0 +1,70 @@
+#include "../header/SampleImage.hpp"
+#include "../header/PngWriter.hpp"
+
+// Copies a decoded stb buffer into the image, keeping the file's own channel layout
+template <typename T>
+static bool adoptSamples(T* data, int width, int height, int channels, SampleImage<T>& image) {
+    if (!data) return false;
+    image.create(width, height, channels);
+    size_t rowSamples = static_cast<size_t>(width) * channels;
+    for (int y = 0; y < height; y++) {
+        std::copy(data + y * rowSamples, data + (y + 1) * rowSamples, image.row(y));
+    }
+    stbi_image_free(data);
+    return true;
+}
+
+static std::string extensionOf(const std::string& filepath) {
+    return filepath.substr(filepath.find_last_of(".") + 1);
+}
+
+// stb_image_write only produces 8-bit PNGs, so 16-bit images go through PngWriter with
+// big-endian samples
+static bool writePng16(const std::string& filepath, const SampleImage<uint16_t>& image) {
+    const int width = image.getWidth(), channels = image.getChannels();
+    PngWriter writer(width, image.getHeight(), channels, 16);
+    return writer.write(filepath, [&](int y, uint8_t* out) {
+        const uint16_t* row = image.row(y);
+        for (int i = 0; i < width * channels; i++) {
+            *out++ = static_cast<uint8_t>(row[i] >> 8);
+            *out++ = static_cast<uint8_t>(row[i]);
+        }
+    });
+}
+
+template <>
+bool SampleImage<uint16_t>::loadImage(const std::string& filepath) {
+    // 8-bit files are widened by stb to the full 16-bit range
+    int w, h, c;
+    unsigned short* data = stbi_load_16(filepath.c_str(), &w, &h, &c, 0);
+    return adoptSamples(data, w, h, c, *this);
+}
+
+template <>
+bool SampleImage<float>::loadImage(const std::string& filepath) {
+    // HDR files load as is; LDR files are scaled linearly to [0, 1], without stb's default gamma
+    // curve
+    stbi_ldr_to_hdr_gamma(1.0f);
+    int w, h, c;
+    float* data = stbi_loadf(filepath.c_str(), &w, &h, &c, 0);
+    return adoptSamples(data, w, h, c, *this);
+}
+
+template <>
+bool SampleImage<uint16_t>::saveImage(const std::string& filepath) const {
+    std::string ext = extensionOf(filepath);
+    if (ext == "png") return writePng16(filepath, *this);
+    if (ext == "jpg" || ext == "jpeg") {
+        // JPEG is 8-bit only
+        std::vector<uint8_t> narrow(samples.size());
+        for (size_t i = 0; i < samples.size(); i++) narrow[i] = static_cast<uint8_t>((samples[i] + 128) / 257);
+        return stbi_write_jpg(filepath.c_str(), width, height, channels, narrow.data(), 90);
+    }
+    return false;
+}
+
+template <>
+bool SampleImage<float>::saveImage(const std::string& filepath) const {
+    if (extensionOf(filepath) != "hdr") return false;
+    return stbi_write_hdr(filepath.c_str(), width, height, channels, samples.data());
+}
@@ -0,0 +1,227 @@
+#include "../header/StatisticsPyramid.hpp"
+#include <algorithm>
+
+void BlockStatistics::reset(int channels, bool withHistogram) {
+    this->channels = channels;
+    count = 0;
+    for (int c = 0; c < ChannelLayout::maxChannels; c++) {
+        sum[c] = 0;
+        sumSquares[c] = 0;
+        minValue[c] = 255;
+        maxValue[c] = 0;
+    }
+    histogram.assign(withHistogram ? 256 * channels : 0, 0);
+}
+
+void BlockStatistics::addPixel(const Pixel& p) {
+    ChannelLayout::dispatch(channels, [&](auto layout) {
+        constexpr int C = decltype(layout)::value;
+        uint8_t samples[C];
+        ChannelLayout::extract<C>(p, samples);
+        addSamples<C>(samples);
+    });
+}
+
+void StatisticsPyramid::Level::allocate(int width, int height, int channels) {
+    gridWidth = width;
+    gridHeight = height;
+    size_t cells = static_cast<size_t>(width) * height;
+    counts.assign(cells, 0);
+    sums.assign(cells * channels, 0);
+    sumSquares.assign(cells * channels, 0);
+    minValues.assign(cells * channels, 255);
+    maxValues.assign(cells * channels, 0);
+}
+
+StatisticsPyramid::StatisticsPyramid(const ImagePixel& image, bool withHistograms)
+    : image(image), withHistograms(withHistograms), channels(image.getChannels()), topLevel(baseLevel) {
+    int size = std::max(image.getWidth(), image.getHeight());
+    while ((1 << topLevel) < size) topLevel++;
+
+    ChannelLayout::dispatch(channels, [&](auto layout) {
+        constexpr int C = decltype(layout)::value;
+        buildBaseLevel<C>();
+        for (int level = baseLevel + 1; level <= topLevel; level++) {
+            buildLevel<C>(level);
+        }
+    });
+}
+
+bool StatisticsPyramid::hasHistograms() const { return withHistograms; }
+int StatisticsPyramid::getChannels() const { return channels; }
+int StatisticsPyramid::getLevelCount() const { return static_cast<int>(levels.size()); }
+const ImagePixel& StatisticsPyramid::getImage() const { return image; }
+
+template <int C>
+void StatisticsPyramid::buildBaseLevel() {
+    const int width = image.getWidth();
+    const int height = image.getHeight();
+
+    Level base;
+    base.allocate((width + (1 << baseLevel) - 1) >> baseLevel,
+                  (height + (1 << baseLevel) - 1) >> baseLevel, C);
+
+    for (int y = 0; y < height; y++) {
+        size_t rowOffset = static_cast<size_t>(y >> baseLevel) * base.gridWidth;
+        const uint8_t* row = image.getRow(y);
+        for (int x = 0; x < width; x++) {
+            const uint8_t* samples = row + x * C;
+            size_t index = rowOffset + (x >> baseLevel);
+            base.counts[index]++;
+            for (int c = 0; c < C; c++) {
+                size_t slot = index * C + c;
+                base.sums[slot] += samples[c];
+                base.sumSquares[slot] += static_cast<uint64_t>(samples[c]) * samples[c];
+                base.minValues[slot] = std::min(base.minValues[slot], samples[c]);
+                base.maxValues[slot] = std::max(base.maxValues[slot], samples[c]);
+            }
+        }
+    }
+
+    levels.push_back(std::move(base));
+}
+
+template <int C>
+void StatisticsPyramid::buildLevel(int level) {
+    const Level& finer = levels.back();
+    const int bins = 256 * C;
+
+    Level current;
+    current.allocate((finer.gridWidth + 1) / 2, (finer.gridHeight + 1) / 2, C);
+
+    for (int cy = 0; cy < current.gridHeight; cy++) {
+        for (int cx = 0; cx < current.gridWidth; cx++) {
+            size_t index = static_cast<size_t>(cy) * current.gridWidth + cx;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    int fx = cx * 2 + dx, fy = cy * 2 + dy;
+                    if (fx >= finer.gridWidth || fy >= finer.gridHeight) continue;
+                    size_t child = static_cast<size_t>(fy) * finer.gridWidth + fx;
+                    current.counts[index] += finer.counts[child];
+                    for (int c = 0; c < C; c++) {
+                        size_t slot = index * C + c, childSlot = child * C + c;
+                        current.sums[slot] += finer.sums[childSlot];
+                        current.sumSquares[slot] += finer.sumSquares[childSlot];
+                        current.minValues[slot] = std::min(current.minValues[slot], finer.minValues[childSlot]);
+                        current.maxValues[slot] = std::max(current.maxValues[slot], finer.maxValues[childSlot]);
+                    }
+                }
+            }
+        }
+    }
+
+    if (withHistograms && level == histogramLevel) {
+        // First histogram level is scanned from the pixels themselves
+        current.histograms.assign(current.counts.size() * bins, 0);
+        for (int y = 0; y < image.getHeight(); y++) {
+            size_t rowOffset = static_cast<size_t>(y >> level) * current.gridWidth;
+            const uint8_t* row = image.getRow(y);
+            for (int x = 0; x < image.getWidth(); x++) {
+                uint32_t* hist = &current.histograms[(rowOffset + (x >> level)) * bins];
+                const uint8_t* samples = row + x * C;
+                for (int c = 0; c < C; c++) hist[c * 256 + samples[c]]++;
+            }
+        }
+    } else if (withHistograms && level > histogramLevel) {
+        current.histograms.assign(current.counts.size() * bins, 0);
+        for (int cy = 0; cy < current.gridHeight; cy++) {
+            for (int cx = 0; cx < current.gridWidth; cx++) {
+                uint32_t* hist = &current.histograms[(static_cast<size_t>(cy) * current.gridWidth + cx) * bins];
+                for (int dy = 0; dy < 2; dy++) {
+                    for (int dx = 0; dx < 2; dx++) {
+                        int fx = cx * 2 + dx, fy = cy * 2 + dy;
+                        if (fx >= finer.gridWidth || fy >= finer.gridHeight) continue;
+                        const uint32_t* childHist = &finer.histograms[(static_cast<size_t>(fy) * finer.gridWidth + fx) * bins];
+                        for (int i = 0; i < bins; i++) hist[i] += childHist[i];
+                    }
+                }
+            }
+        }
+    }
+
+    levels.push_back(std::move(current));
+}
+
+void StatisticsPyramid::query(int x, int y, int width, int height,
+                              BlockStatistics& stats, bool withHistogram) const {
+    stats.reset(channels, withHistogram);
+
+    int x0 = std::max(x, 0), y0 = std::max(y, 0);
+    int x1 = std::min(x + width, image.getWidth());
+    int y1 = std::min(y + height, image.getHeight());
+    if (x0 >= x1 || y0 >= y1) return;
+
+    ChannelLayout::dispatch(channels, [&](auto layout) {
+        queryCell<decltype(layout)::value>(topLevel, 0, 0, x0, y0, x1, y1, stats, withHistogram);
+    });
+}
+
+template <int C>
+void StatisticsPyramid::queryCell(int level, int cx, int cy, int x0, int y0, int x1, int y1,
+                                  BlockStatistics& stats, bool withHistogram) const {
+    // Cell extent clipped to the image
+    int cellX0 = cx << level, cellY0 = cy << level;
+    if (cellX0 >= image.getWidth() || cellY0 >= image.getHeight()) return;
+    int cellX1 = std::min(cellX0 + (1 << level), image.getWidth());
+    int cellY1 = std::min(cellY0 + (1 << level), image.getHeight());
+
+    int ix0 = std::max(cellX0, x0), iy0 = std::max(cellY0, y0);
+    int ix1 = std::min(cellX1, x1), iy1 = std::min(cellY1, y1);
+    if (ix0 >= ix1 || iy0 >= iy1) return;
+
+    bool covered = (ix0 == cellX0 && iy0 == cellY0 && ix1 == cellX1 && iy1 == cellY1);
+    if (covered) {
+        const Level& lvl = levels[level - baseLevel];
+        size_t index = static_cast<size_t>(cy) * lvl.gridWidth + cx;
+
+        stats.count += lvl.counts[index];
+        for (int c = 0; c < C; c++) {
+            size_t slot = index * C + c;
+            stats.sum[c] += lvl.sums[slot];
+            stats.sumSquares[c] += lvl.sumSquares[slot];
+            stats.minValue[c] = std::min(stats.minValue[c], lvl.minValues[slot]);
+            stats.maxValue[c] = std::max(stats.maxValue[c], lvl.maxValues[slot]);
+        }
+
+        if (withHistogram) {
+            if (!lvl.histograms.empty()) {
+                const uint32_t* hist = &lvl.histograms[index * 256 * C];
+                for (int i = 0; i < 256 * C; i++) stats.histogram[i] += hist[i];
+            } else {
+                scanHistogram<C>(cellX0, cellY0, cellX1, cellY1, stats);
+            }
+        }
+        return;
+    }
+
+    if (level == baseLevel) {
+        scanPixels<C>(ix0, iy0, ix1, iy1, stats);
+        return;
+    }
+
+    for (int dy = 0; dy < 2; dy++) {
+        for (int dx = 0; dx < 2; dx++) {
+            queryCell<C>(level - 1, cx * 2 + dx, cy * 2 + dy, x0, y0, x1, y1, stats, withHistogram);
+        }
+    }
+}
+
+template <int C>
+void StatisticsPyramid::scanPixels(int x0, int y0, int x1, int y1, BlockStatistics& stats) const {
+    // addSamples also fills the histogram when the query asked for one
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* row = image.getRow(y);
+        for (int x = x0; x < x1; x++) stats.addSamples<C>(row + x * C);
+    }
+}
+
+template <int C>
+void StatisticsPyramid::scanHistogram(int x0, int y0, int x1, int y1, BlockStatistics& stats) const {
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* row = image.getRow(y);
+        for (int x = x0; x < x1; x++) {
+            const uint8_t* samples = row + x * C;
+            for (int c = 0; c < C; c++) stats.histogram[c * 256 + samples[c]]++;
+        }
+    }
+}
@@ -0,0 +1,156 @@
+#include "../header/ThresholdSweep.hpp"
+#include "../header/QuadTreeCodec.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+ThresholdSweep::ThresholdSweep(ImagePixel& image, ErrorCalculator::ErrorMethod method, int minBlockSize,
+                               QuadTreeCompressor::SplitPolicy policy)
+    : image(image), baseBlockSize(minBlockSize), policy(policy),
+      compressor(image, method, -std::numeric_limits<double>::infinity(), minBlockSize) {
+    // A threshold of -inf refines every block down to the minimum size
+    compressor.setSplitPolicy(policy);
+    compressor.compress();
+}
+
+std::vector<SweepResult> ThresholdSweep::run(const std::vector<double>& thresholds, const std::vector<int>& blockSizes) {
+    std::vector<double> sorted(thresholds);
+    std::sort(sorted.begin(), sorted.end());
+    const size_t count = sorted.size();
+    const double pixelSamples = static_cast<double>(image.getChannels()) * image.getWidth() * image.getHeight();
+
+    std::vector<SweepResult> results;
+    const QuadTreeNode* root = compressor.getRoot();
+    if (!root || count == 0) return results;
+
+    for (int blockSize : blockSizes) {
+        int minBlockSize = std::max(blockSize, baseBlockSize);
+
+        Accumulator acc;
+        acc.nodeDiff.assign(count + 1, 0);
+        acc.leafDiff.assign(count + 1, 0);
+        acc.squaredErrorDiff.assign(count + 1, 0.0);
+        acc.binaryDiff.assign(count + 1, 0);
+        acc.offMiddleDiff.assign(count + 1, 0);
+        acc.cutBytesDiff.assign(count + 1, 0);
+        acc.depthAtPrefix.assign(count + 1, 0);
+        sweepNode(root, 1, std::numeric_limits<double>::infinity(), minBlockSize, sorted, acc);
+
+        // Prefix sums turn the per-node ranges into per-threshold totals; depth is a suffix max
+        std::vector<int> depths(count + 1, 0);
+        for (size_t k = count; k-- > 0;) {
+            depths[k] = std::max(depths[k + 1], acc.depthAtPrefix[k + 1]);
+        }
+
+        long long nodes = 0, leaves = 0, binaryNodes = 0, offMiddle = 0, cutBytes = 0;
+        double squaredError = 0.0;
+        for (size_t k = 0; k < count; k++) {
+            nodes += acc.nodeDiff[k];
+            leaves += acc.leafDiff[k];
+            squaredError += acc.squaredErrorDiff[k];
+            binaryNodes += acc.binaryDiff[k];
+            offMiddle += acc.offMiddleDiff[k];
+            cutBytes += acc.cutBytesDiff[k];
+
+            SweepResult result;
+            result.threshold = sorted[k];
+            result.minBlockSize = minBlockSize;
+            result.nodeCount = static_cast<int>(nodes);
+            result.leafCount = static_cast<int>(leaves);
+            result.treeDepth = depths[k];
+            result.mse = pixelSamples > 0 ? squaredError / pixelSamples : 0.0;
+            result.psnr = result.mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / result.mse)
+                                         : std::numeric_limits<double>::infinity();
+            // Same version and offset flags as QuadTreeCodec::encode picks for the cut tree
+            result.encodedBytes = QuadTreeCodec::encodedSize(result.nodeCount, result.leafCount, binaryNodes > 0,
+                                                             offMiddle > 0 ? static_cast<size_t>(cutBytes) : 0,
+                                                             image.getChannels());
+            results.push_back(result);
+        }
+    }
+
+    return results;
+}
+
+void ThresholdSweep::sweepNode(const QuadTreeNode* node, int depth, double pathMin, int minBlockSize,
+                               const std::vector<double>& thresholds, Accumulator& acc) const {
+    // The node exists for every threshold below the smallest ancestor error
+    size_t present = std::lower_bound(thresholds.begin(), thresholds.end(), pathMin) - thresholds.begin();
+    if (present == 0) return;
+
+    acc.nodeDiff[0]++;
+    acc.nodeDiff[present]--;
+    acc.depthAtPrefix[present] = std::max(acc.depthAtPrefix[present], depth);
+
+    bool finalLeaf = node->isLeaf || !QuadTreeCompressor::childrenFit(node, minBlockSize);
+    size_t leafFrom = finalLeaf ? 0
+                    : std::lower_bound(thresholds.begin(), thresholds.end(), node->error) - thresholds.begin();
+    leafFrom = std::min(leafFrom, present);
+    if (leafFrom < present) {
+        acc.leafDiff[leafFrom]++;
+        acc.leafDiff[present]--;
+        acc.squaredErrorDiff[leafFrom] += node->squaredError;
+        acc.squaredErrorDiff[present] -= node->squaredError;
+    }
+
+    if (finalLeaf) return;
+    if (!node->children[2] && leafFrom > 0) {
+        // A binary node while it stays internal; same cut as QuadTreeCodec::codeOf
+        bool acrossX = node->children[1]->x != node->children[0]->x;
+        int cut = acrossX ? node->children[0]->width : node->children[0]->height;
+        int half = (acrossX ? node->width : node->height) / 2;
+        long long bytes = static_cast<long long>(QuadTreeCodec::varintSize(static_cast<uint32_t>(cut)));
+        acc.binaryDiff[0]++;
+        acc.binaryDiff[leafFrom]--;
+        acc.cutBytesDiff[0] += bytes;
+        acc.cutBytesDiff[leafFrom] -= bytes;
+        if (cut != half) {
+            acc.offMiddleDiff[0]++;
+            acc.offMiddleDiff[leafFrom]--;
+        }
+    }
+    double childPathMin = std::min(pathMin, node->error);
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i]) sweepNode(node->children[i].get(), depth + 1, childPathMin, minBlockSize, thresholds, acc);
+    }
+}
+
+void ThresholdSweep::render(double threshold, int minBlockSize, ImagePixel& outputImage) const {
+    if (!compressor.getRoot()) return;
+
+    outputImage.create(image.getWidth(), image.getHeight(), image.getChannels());
+    renderNode(compressor.getRoot(), threshold, std::max(minBlockSize, baseBlockSize), outputImage);
+}
+
+void ThresholdSweep::renderNode(const QuadTreeNode* node, double threshold, int minBlockSize,
+                                ImagePixel& outputImage) const {
+    bool leaf = node->isLeaf || node->error <= threshold ||
+                !QuadTreeCompressor::childrenFit(node, minBlockSize);
+    if (leaf) {
+        for (int y = node->y; y < node->y + node->height; y++) {
+            if (!node->hasGradient) {
+                outputImage.fillSpan(y, node->x, node->x + node->width, node->averageColor);
+                continue;
+            }
+            for (int x = node->x; x < node->x + node->width; x++) outputImage.setPixel(x, y, node->colorAt(x, y));
+        }
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i]) renderNode(node->children[i].get(), threshold, minBlockSize, outputImage);
+    }
+}
+
+void ThresholdSweep::printTable(const std::vector<SweepResult>& results, std::ostream& out) {
+    out << std::left << std::setw(12) << "threshold" << std::setw(10) << "minBlock"
+        << std::setw(10) << "nodes" << std::setw(10) << "leaves" << std::setw(8) << "depth"
+        << std::setw(12) << "MSE" << std::setw(10) << "PSNR" << "bytes" << "\n";
+    for (const SweepResult& r : results) {
+        out << std::left << std::setw(12) << r.threshold << std::setw(10) << r.minBlockSize
+            << std::setw(10) << r.nodeCount << std::setw(10) << r.leafCount << std::setw(8) << r.treeDepth
+            << std::setw(12) << std::fixed << std::setprecision(3) << r.mse
+            << std::setw(10) << std::setprecision(2) << r.psnr << std::defaultfloat << std::setprecision(6)
+            << r.encodedBytes << "\n";
+    }
+}
@@ -1,34 +1,273 @@
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
 #include "../header/ImagePixel.hpp"
 #include "../header/ErrorCalculator.hpp"
+#include "../header/MetricRegistry.hpp"
 #include "../header/QuadTreeNode.hpp"
+#include "../header/ThresholdSweep.hpp"
+#include "../header/QualityMetrics.hpp"
+#include "../header/SampleCompressor.hpp"
+#include "../header/LinearQuadTree.hpp"
+#include "../header/QuadTreeQuery.hpp"
+#include "../header/QuadTreeRenderer.hpp"
+#include "../header/QuadTreePngEncoder.hpp"
+#include "../header/QuadTreeJpegEncoder.hpp"
+#include "../header/QuadTreeSvgWriter.hpp"
+#include "../header/QuadTreeCodec.hpp"
+#include "../header/Parallel.hpp"
+
+// Returns the value of an optional "--name=value" argument, or fallback when it is absent
+static std::string getOption(int argc, char* argv[], const std::string& name, const std::string& fallback = "") {
+    std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0) return arg.substr(prefix.size());
+    }
+    return fallback;
+}
+
+static bool hasFlag(int argc, char* argv[], const std::string& name) {
+    std::string flag = "--" + name;
+    for (int i = 1; i < argc; i++) {
+        if (flag == argv[i]) return true;
+    }
+    return false;
+}
+
+// True when "--name" is given as a flag or with a value
+static bool hasOption(int argc, char* argv[], const std::string& name) {
+    std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]).compare(0, prefix.size(), prefix) == 0) return true;
+    }
+    return hasFlag(argc, argv, name);
+}
+
+// Throws std::invalid_argument naming the first of the options that is given, for modes that
+// cannot honor them
+static void rejectOptions(int argc, char* argv[], std::initializer_list<const char*> options,
+                          const std::string& reason) {
+    for (const char* option : options) {
+        if (hasOption(argc, argv, option)) throw std::invalid_argument("--" + std::string(option) + " " + reason);
+    }
+}
+
+// Parses a comma separated list such as "0.01,0.05,0.1"; throws std::invalid_argument on an
+// item that is not entirely a number
+template <typename T>
+static std::vector<T> parseList(const std::string& text) {
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) continue;
+        size_t used = 0;
+        double value = 0.0;
+        try {
+            value = std::stod(item, &used);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used != item.size()) throw std::invalid_argument("Not a number in list: " + item);
+        values.push_back(static_cast<T>(value));
+    }
+    return values;
+}
+
+static PngWriter::Level parsePngLevel(const std::string& pngLevel) {
+    if (pngLevel == "stored") return PngWriter::STORED_LEVEL;
+    if (pngLevel == "fast") return PngWriter::FAST_LEVEL;
+    if (pngLevel == "default") return PngWriter::DEFAULT_LEVEL;
+    throw std::invalid_argument("Unknown PNG level: " + pngLevel);
+}
+
+// Saves through stb, or through the striped PngWriter when a --png-level is given. With a tree,
+// PNG and JPEG output is encoded from its leaves (see QuadTreePngEncoder, QuadTreeJpegEncoder);
+// the JPEG bytes are the same as stb's
+static bool saveOutput(const ImagePixel& image, const std::string& path, const std::string& pngLevel,
+                       const QuadTreeNode* tree = nullptr) {
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+    if (tree && (ext == "jpg" || ext == "jpeg")) return QuadTreeJpegEncoder(tree).write(path);
+    if (pngLevel.empty() || ext != "png") return image.saveImage(path);
+    PngWriter::Level level = parsePngLevel(pngLevel);
+    if (!tree) return PngWriter::writeImage(path, image, level);
+    QuadTreePngEncoder encoder(tree, image.getChannels());
+    encoder.setLevel(level);
+    return encoder.write(path);
+}
+
+// Bytes saveOutput writes for a tree when they come from the tree's own encoders; empty when stb
+// writes the reconstructed image, whose pixels are compared instead
+static std::vector<uint8_t> encodeOutput(const QuadTreeNode* tree, int channels, const std::string& path,
+                                         const std::string& pngLevel) {
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+    if (ext == "jpg" || ext == "jpeg") return QuadTreeJpegEncoder(tree).encode();
+    if (pngLevel.empty() || ext != "png") return {};
+    QuadTreePngEncoder encoder(tree, channels);
+    encoder.setLevel(parsePngLevel(pngLevel));
+    return encoder.encode();
+}
+
+// Compares a tree built with the default thread limit against a reference built on one thread:
+// the tree's structure, colors and statistics, then each tree's reconstruction, output bytes and
+// quality metrics, computed at the thread count it was built with. Returns what differs, nothing
+// when the runs agree
+static std::vector<std::string> compareWithSerial(const QuadTreeCompressor& parallel, const QuadTreeCompressor& serial,
+                                                  const ImagePixel& image, const std::string& outputPath,
+                                                  const std::string& pngLevel, int threads) {
+    std::vector<std::string> differences;
+    const int width = image.getWidth(), height = image.getHeight(), channels = image.getChannels();
+    if (parallel.getNodeCount() != serial.getNodeCount() || parallel.getTreeDepth() != serial.getTreeDepth()) {
+        differences.push_back("node count or depth");
+    }
+    if (QuadTreeCodec::encode(parallel.getRoot(), width, height, parallel.getPalette(), channels) !=
+        QuadTreeCodec::encode(serial.getRoot(), width, height, serial.getPalette(), channels)) {
+        differences.push_back("encoded tree");
+    }
+    if (QualityMetrics::analyticMSE(parallel.getRoot(), width, height, channels) !=
+        QualityMetrics::analyticMSE(serial.getRoot(), width, height, channels)) {
+        differences.push_back("leaf squared error");
+    }
+
+    ImagePixel reconstructed[2];
+    std::vector<uint8_t> output[2];
+    QualityReport quality[2];
+    const int limits[2] = {threads, 1};
+    const QuadTreeCompressor* trees[2] = {&parallel, &serial};
+    for (int i = 0; i < 2; i++) {
+        Parallel::setThreadLimit(limits[i]);
+        trees[i]->reconstruct(reconstructed[i]);
+        output[i] = encodeOutput(trees[i]->getRoot(), channels, outputPath, pngLevel);
+        quality[i] = QualityMetrics::compare(image, reconstructed[i]);
+    }
+    Parallel::setThreadLimit(threads);
+    const ImagePixel& parallelImage = reconstructed[0];
+    const ImagePixel& serialImage = reconstructed[1];
+    if (parallelImage.getSamples() != serialImage.getSamples()) {
+        differences.push_back("reconstructed pixels");
+    }
+    if (output[0] != output[1]) differences.push_back("output bytes");
+    if (quality[0].mse != quality[1].mse || quality[0].ssim != quality[1].ssim) {
+        differences.push_back("quality metrics");
+    }
+    return differences;
+}
+
+// Compresses 16-bit or float images at full precision (see SampleCompressor)
+template <typename T>
+static int runSamplePipeline(const std::string& inputPath, const std::string& outputPath,
+                             ErrorCalculator::ErrorMethod method, double threshold, int minBlockSize) {
+    SampleImage<T> image;
+    if (!image.loadImage(inputPath)) {
+        std::cerr << "Failed to load image: " << inputPath << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    SampleCompressor<T> compressor(image, method, threshold, minBlockSize);
+    compressor.compress();
+    SampleImage<T> compressedImage;
+    compressor.reconstruct(compressedImage);
+    if (!compressedImage.saveImage(outputPath)) {
+        std::cerr << "Failed to save compressed image: " << outputPath << std::endl;
+        return 1;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double mse = SampleCompressor<T>::meanSquaredError(image, compressedImage);
+    std::cout << "Execution time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+    std::cout << "Tree depth: " << compressor.getTreeDepth() << "\n";
+    std::cout << "Node count: " << compressor.getNodeCount() << "\n";
+    std::cout << "MSE: " << mse << " (sample units)\n";
+    std::cout << "PSNR: " << SampleCompressor<T>::psnrFromMSE(mse) << " dB\n";
+    return 0;
+}
 
 int main(int argc, char* argv[]) {
     if (argc < 7) {
         std::cerr << "Usage: " << argv[0] << " <input_image> <error_method> <threshold> "
-                  << "<min_block_size> <compression_percentage> <output_image> [output_gif]\n";
+                  << "<min_block_size> <compression_percentage> <output_image> [output_gif] [options]\n"
+                  << "Options:\n"
+                  << "  --sweep=t1,t2,...      evaluate many thresholds on one refined tree of flat leaves\n"
+                  << "  --sweep-blocks=b1,...  minimum block sizes to sweep (default: the prompted one)\n"
+                  << "  --sweep-images         also write one output image per sweep entry\n"
+                  << "  --split=quad|kd|best   split policy (default: quad)\n"
+                  << "  --palette=K            quantize leaf colors to a K-entry palette (2-256)\n"
+                  << "  --leaf-model=flat|plane  flat leaf colors or per-channel gradients (default: flat)\n"
+                  << "  --samples=8|16|float   sample precision of the pipeline (default: 8); 16 and float build flat\n"
+                  << "                         quad trees and write the image only (float as .hdr); tree and output options are rejected\n"
+                  << "  --builder=pyramid|fused|bounded|level  block statistics from the pyramid, from metric-specialized\n"
+                  << "                         scans, or from scans that stop once a block must split (default: bounded);\n"
+                  << "                         level builds from the pyramid one tree level at a time, in parallel\n"
+                  << "  --partition=none|quadrants  fused and bounded builders: build each quadrant on a pinned worker\n"
+                  << "                         from a thread-local copy of its pixels (default: none)\n"
+                  << "  --pixel-order=rows|morton  pixel storage read by the fused and bounded scans (default: rows)\n"
+                  << "  --linear=file.qtl      also save the leaves as a linear (pointerless) quadtree\n"
+                  << "  --viewport=x,y,w,h     also render that region from the tree to <output>_viewport\n"
+                  << "  --zoom=N               viewport downsampling factor (default: 1)\n"
+                  << "  --render-size=WxH      also render the whole tree at that size to <output>_render\n"
+                  << "  --svg=file.svg         also save the leaves as SVG rectangles, merging same-color neighbours\n"
+                  << "  --png-level=stored|fast|default  write PNGs with the multithreaded striped encoder at that\n"
+                  << "                         level, the output straight from the tree (default: stb's encoder)\n"
+                  << "  --threads=N            worker threads (default: one per hardware thread); results do not depend on it\n"
+                  << "  --check-determinism    rebuild and re-encode on one thread and fail unless every result matches:\n"
+                  << "                         the tree, its reconstruction, quality metrics and the output encoder's bytes\n";
+        return 1;
+    }
+    
+    std::string splitName = getOption(argc, argv, "split", "quad");
+    QuadTreeCompressor::SplitPolicy splitPolicy = QuadTreeCompressor::QUAD_SPLIT;
+    if (splitName == "kd") splitPolicy = QuadTreeCompressor::LONGER_AXIS_SPLIT;
+    else if (splitName == "best") splitPolicy = QuadTreeCompressor::BEST_SPLIT;
+    else if (splitName != "quad") {
+        std::cerr << "Unknown split policy: " << splitName << std::endl;
+        return 1;
+    }
+
+    std::string leafModelName = getOption(argc, argv, "leaf-model", "flat");
+    QuadTreeCompressor::LeafModel leafModel = QuadTreeCompressor::FLAT_MODEL;
+    if (leafModelName == "plane") leafModel = QuadTreeCompressor::PLANE_MODEL;
+    else if (leafModelName != "flat") {
+        std::cerr << "Unknown leaf model: " << leafModelName << std::endl;
         return 1;
     }
     
     try {
+        int threadCount = std::stoi(getOption(argc, argv, "threads", "0"));
+        if (threadCount < 0) throw std::invalid_argument("Thread count must not be negative");
+        Parallel::setThreadLimit(threadCount);
+
+        int paletteSize = 0;
+        if (hasOption(argc, argv, "palette")) {
+            paletteSize = std::stoi(getOption(argc, argv, "palette"));
+            if (paletteSize < 2 || paletteSize > 256) throw std::invalid_argument("Palette size must be in 2-256");
+        }
+
+        std::vector<double> sweepThresholds = parseList<double>(getOption(argc, argv, "sweep"));
+        bool sweepMode = !sweepThresholds.empty();
+
         std::string inputPath;
         std::cout << "input path: ";
         std::cin >> inputPath;
 
-        int methodNum;
+        std::string methodSpec;
         std::cout << "error method" << std::endl;
-        std::cout << "1. Variance " << std::endl;
-        std::cout << "2. Mean Absolute Deviation " << std::endl;
-        std::cout << "3. Max Pixel Difference " << std::endl;
-        std::cout << "4. Entropy " << std::endl;
-        std::cout << "Enter method number (1-4): ";
-        std::cin >> methodNum;
+        for (const MetricDescriptor& metric : MetricRegistry::all()) {
+            std::cout << metric.id << ". " << metric.label << " " << std::endl;
+        }
+        std::cout << "Enter method number (1-" << MetricRegistry::all().size() << ", combine with '+', e.g. 1+3): ";
+        std::cin >> methodSpec;
 
-        double threshold;
-        std::cout << "input treshold (0.0-1.0): ";
-        std::cin >> threshold;
+        double threshold = 0.0;
+        if (!sweepMode) {
+            std::cout << "input treshold (0.0-1.0): ";
+            std::cin >> threshold;
+        }
 
         int minBlockSize;
         std::cout << "input minimum block size: ";
@@ -38,14 +277,29 @@ int main(int argc, char* argv[]) {
         std::cout << "output path: ";
         std::cin >> outputPath;
         
-        // Convert method number to enum
-        ErrorCalculator::ErrorMethod method;
-        switch (methodNum) {
-            case 1: method = ErrorCalculator::VARIANCE; break;
-            case 2: method = ErrorCalculator::MEAN_ABSOLUTE_DEVIATION; break;
-            case 3: method = ErrorCalculator::MAX_PIXEL_DIFFERENCE; break;
-            case 4: method = ErrorCalculator::ENTROPY; break;
-            default: throw std::invalid_argument("Invalid error method");
+        // Resolve the method number, key or combination through the registry
+        ErrorCalculator::ErrorMethod method = static_cast<ErrorCalculator::ErrorMethod>(MetricRegistry::parse(methodSpec));
+        
+        // 16-bit and float images take the full precision pipeline
+        std::string samples = getOption(argc, argv, "samples", "8");
+        if (samples != "8") {
+            if (sweepMode) throw std::invalid_argument("Sweep mode works on 8-bit samples only");
+            // The full precision pipeline builds flat quad trees and writes the image only
+            rejectOptions(argc, argv, {"split", "leaf-model", "palette", "builder", "partition", "pixel-order",
+                                       "png-level", "linear", "svg", "viewport", "zoom", "render-size",
+                                       "check-determinism"}, "works on 8-bit samples only");
+            if (samples == "float" && outputPath.substr(outputPath.find_last_of('.') + 1) != "hdr") {
+                throw std::invalid_argument("Float samples are saved as .hdr only");
+            }
+            if (samples == "16") return runSamplePipeline<uint16_t>(inputPath, outputPath, method, threshold, minBlockSize);
+            if (samples == "float") return runSamplePipeline<float>(inputPath, outputPath, method, threshold, minBlockSize);
+            throw std::invalid_argument("Unknown sample type: " + samples);
+        }
+        if (sweepMode) {
+            // The sweep refines one pyramid-built tree of flat leaves and reports its table or images
+            rejectOptions(argc, argv, {"leaf-model", "palette", "builder", "partition", "pixel-order", "linear", "svg",
+                                       "viewport", "zoom", "render-size", "check-determinism"},
+                          "is not supported with --sweep");
         }
         
         // Load the image
@@ -55,20 +309,72 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         
+        std::string pngLevel = getOption(argc, argv, "png-level");
+        
+        std::string pixelOrder = getOption(argc, argv, "pixel-order", "rows");
+        if (pixelOrder == "morton") image.enableMortonTiles();
+        else if (pixelOrder != "rows") throw std::invalid_argument("Unknown pixel order: " + pixelOrder);
+        
+        if (sweepMode) {
+            std::vector<int> blockSizes = parseList<int>(getOption(argc, argv, "sweep-blocks"));
+            if (blockSizes.empty()) blockSizes.push_back(minBlockSize);
+            int smallestBlock = *std::min_element(blockSizes.begin(), blockSizes.end());
+
+            auto start = std::chrono::high_resolution_clock::now();
+            ThresholdSweep sweep(image, method, smallestBlock, splitPolicy);
+            std::vector<SweepResult> results = sweep.run(sweepThresholds, blockSizes);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            ThresholdSweep::printTable(results, std::cout);
+            std::cout << "Sweep time: "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+
+            if (hasFlag(argc, argv, "sweep-images")) {
+                size_t dot = outputPath.find_last_of(".");
+                std::string stem = outputPath.substr(0, dot);
+                std::string ext = dot == std::string::npos ? "" : outputPath.substr(dot);
+                for (const SweepResult& result : results) {
+                    ImagePixel sweepImage;
+                    sweep.render(result.threshold, result.minBlockSize, sweepImage);
+                    std::string path = stem + "_t" + std::to_string(result.threshold) +
+                                       "_b" + std::to_string(result.minBlockSize) + ext;
+                    if (!saveOutput(sweepImage, path, pngLevel)) {
+                        std::cerr << "Failed to save sweep image: " << path << std::endl;
+                        return 1;
+                    }
+                }
+            }
+            return 0;
+        }
+        
         // Start timer
         auto start = std::chrono::high_resolution_clock::now();
         
-        // Compress the image
+        // Compress the image; --check-determinism builds a second tree the same way
+        std::string builder = getOption(argc, argv, "builder", "bounded");
+        std::string partition = getOption(argc, argv, "partition", "none");
+        auto buildTree = [&](QuadTreeCompressor& target) {
+            target.setSplitPolicy(splitPolicy);
+            target.setLeafModel(leafModel);
+            if (builder == "pyramid") target.setBuildStrategy(QuadTreeCompressor::PYRAMID_BUILD);
+            else if (builder == "fused") target.setBuildStrategy(QuadTreeCompressor::FUSED_BUILD);
+            else if (builder == "bounded") target.setBuildStrategy(QuadTreeCompressor::BOUNDED_BUILD);
+            else if (builder == "level") target.setBuildStrategy(QuadTreeCompressor::LEVEL_BUILD);
+            else throw std::invalid_argument("Unknown builder: " + builder);
+            if (partition == "quadrants") target.setPartitioned(true);
+            else if (partition != "none") throw std::invalid_argument("Unknown partition: " + partition);
+            target.compress();
+            if (paletteSize > 0) target.applyPalette(paletteSize);
+        };
         QuadTreeCompressor compressor(image, method, threshold, minBlockSize);
-        compressor.compress();
+        buildTree(compressor);
         
         // Reconstruct the compressed image
         ImagePixel compressedImage;
-        compressedImage.createFromMatrix(image.getPixelMatrix()); // Initialize with same dimensions
         compressor.reconstruct(compressedImage);
         
         // Save the compressed image
-        if (!compressedImage.saveImage(outputPath)) {
+        if (!saveOutput(compressedImage, outputPath, pngLevel, compressor.getRoot())) {
             std::cerr << "Failed to save compressed image: " << outputPath << std::endl;
             return 1;
         }
@@ -82,7 +388,92 @@ int main(int argc, char* argv[]) {
         std::cout << "Tree depth: " << compressor.getTreeDepth() << "\n";
         std::cout << "Node count: " << compressor.getNodeCount() << "\n";
         
-        // TODO: Calculate and output compression percentage, original and compressed sizes
+        // Quality and size of the result
+        QualityReport quality = QualityMetrics::compare(image, compressedImage);
+        std::cout << "MSE: " << quality.mse << " (from leaves: "
+                  << QualityMetrics::analyticMSE(compressor.getRoot(), image.getWidth(), image.getHeight(), image.getChannels()) << ")\n";
+        std::cout << "PSNR: " << quality.psnr << " dB\n";
+        std::cout << "SSIM: " << quality.ssim << "\n";
+        std::cout << "Encoded tree size: " << QualityMetrics::encodedSize(compressor.getRoot(), compressor.getPalette(), image.getChannels()) << " bytes\n";
+        
+        if (hasFlag(argc, argv, "check-determinism")) {
+            const int threads = Parallel::threadLimit();
+            Parallel::setThreadLimit(1);
+            QuadTreeCompressor serial(image, method, threshold, minBlockSize);
+            buildTree(serial);
+            Parallel::setThreadLimit(threads);
+            std::vector<std::string> differences = compareWithSerial(compressor, serial, image, outputPath, pngLevel, threads);
+            if (!differences.empty()) {
+                std::cerr << "Determinism check failed, " << threads << " threads vs 1 differ in:";
+                for (const std::string& difference : differences) std::cerr << " " << difference << ";";
+                std::cerr << std::endl;
+                return 1;
+            }
+            std::cout << "Determinism check: " << threads << " threads match the 1-thread reference\n";
+        }
+        
+        std::string linearPath = getOption(argc, argv, "linear");
+        if (!linearPath.empty()) {
+            LinearQuadTree linear = LinearQuadTree::fromTree(compressor.getRoot(), image.getWidth(), image.getHeight(), image.getChannels());
+            if (!linear.saveToFile(linearPath)) {
+                std::cerr << "Failed to save linear tree: " << linearPath << std::endl;
+                return 1;
+            }
+            std::cout << "Linear tree: " << linear.getLeaves().size() << " leaves, " << linear.memoryBytes()
+                      << " bytes (pointer tree: " << compressor.getNodeCount() * sizeof(QuadTreeNode) << " bytes)\n";
+        }
+        
+        std::string svgPath = getOption(argc, argv, "svg");
+        if (!svgPath.empty()) {
+            QuadTreeSvgWriter svg(compressor.getRoot(), image.getChannels());
+            if (!svg.saveToFile(svgPath)) {
+                std::cerr << "Failed to save SVG: " << svgPath << std::endl;
+                return 1;
+            }
+            std::cout << "SVG: " << svg.getShapeCount() << " shapes -> " << svgPath << "\n";
+        }
+        
+        std::vector<int> viewport = parseList<int>(getOption(argc, argv, "viewport"));
+        if (!viewport.empty()) {
+            if (viewport.size() != 4) throw std::invalid_argument("Viewport needs x,y,width,height");
+            ImagePixel viewportImage;
+            QuadTreeQuery query(compressor.getRoot(), image.getChannels());
+            query.renderViewport(BlockRect{viewport[0], viewport[1], viewport[2], viewport[3]},
+                                 std::stoi(getOption(argc, argv, "zoom", "1")), viewportImage);
+            size_t dot = outputPath.find_last_of('.');
+            std::string path = outputPath.substr(0, dot) + "_viewport" + (dot == std::string::npos ? "" : outputPath.substr(dot));
+            if (!saveOutput(viewportImage, path, pngLevel)) {
+                std::cerr << "Failed to save viewport image: " << path << std::endl;
+                return 1;
+            }
+            std::cout << "Viewport: " << viewportImage.getWidth() << "x" << viewportImage.getHeight() << " -> " << path << "\n";
+        }
+        
+        std::string renderSize = getOption(argc, argv, "render-size");
+        if (!renderSize.empty()) {
+            size_t cross = renderSize.find('x');
+            if (cross == std::string::npos) throw std::invalid_argument("Render size needs WIDTHxHEIGHT");
+            ImagePixel renderImage;
+            QuadTreeRenderer(compressor.getRoot(), image.getChannels())
+                .render(std::stoi(renderSize.substr(0, cross)), std::stoi(renderSize.substr(cross + 1)), renderImage);
+            size_t dot = outputPath.find_last_of('.');
+            std::string path = outputPath.substr(0, dot) + "_render" + (dot == std::string::npos ? "" : outputPath.substr(dot));
+            if (!saveOutput(renderImage, path, pngLevel)) {
+                std::cerr << "Failed to save rendered image: " << path << std::endl;
+                return 1;
+            }
+            std::cout << "Render: " << renderImage.getWidth() << "x" << renderImage.getHeight() << " -> " << path << "\n";
+        }
+        
+        std::error_code sizeError;
+        auto originalSize = std::filesystem::file_size(inputPath, sizeError);
+        auto compressedSize = std::filesystem::file_size(outputPath, sizeError);
+        if (!sizeError && originalSize > 0) {
+            std::cout << "Original size: " << originalSize << " bytes\n";
+            std::cout << "Compressed size: " << compressedSize << " bytes\n";
+            std::cout << "Compression percentage: "
+                      << (1.0 - static_cast<double>(compressedSize) / originalSize) * 100.0 << "%\n";
+        }
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/header/ImagePixel.hpp"
+#include "../src/header/QuadTreeNode.hpp"
+#include "../src/header/QuadTreeCodec.hpp"
+#include "../src/header/MetricTreeBuilder.hpp"
+
+struct BuilderCase {
+    const char* name;
+    QuadTreeCompressor::BuildStrategy strategy;
+    bool partitioned;
+    bool morton;
+    // Bounded scans for the histogram metrics too, which compress() keeps on the plain fused scans
+    bool histogramBounds;
+};
+
+static std::vector<uint8_t> encodeTree(ImagePixel& image, const BuilderCase& builder,
+                                       ErrorCalculator::ErrorMethod method, double threshold, int minBlockSize) {
+    QuadTreeCompressor compressor(image, method, threshold, minBlockSize);
+    compressor.setBuildStrategy(builder.strategy);
+    compressor.setPartitioned(builder.partitioned);
+    if (builder.histogramBounds && method == ErrorCalculator::MEAN_ABSOLUTE_DEVIATION) {
+        compressor.compressWith<MeanAbsoluteDeviationMetric>(true);
+    } else if (builder.histogramBounds && method == ErrorCalculator::ENTROPY) {
+        compressor.compressWith<EntropyMetric>(true);
+    } else {
+        compressor.compress();
+    }
+    return QuadTreeCodec::encode(compressor.getRoot(), image.getWidth(), image.getHeight(),
+                                 compressor.getPalette(), image.getChannels());
+}
+
+// Average of the color samples, alpha dropped
+static ImagePixel grayCopy(const ImagePixel& image) {
+    const int colors = image.getChannels() >= 3 ? 3 : 1;
+    std::vector<uint8_t> samples;
+    samples.reserve(static_cast<size_t>(image.getWidth()) * image.getHeight());
+    for (int y = 0; y < image.getHeight(); y++) {
+        const uint8_t* row = image.getRow(y);
+        for (int x = 0; x < image.getWidth(); x++) {
+            const uint8_t* pixel = row + x * image.getChannels();
+            int sum = 0;
+            for (int c = 0; c < colors; c++) sum += pixel[c];
+            samples.push_back(static_cast<uint8_t>((sum + colors / 2) / colors));
+        }
+    }
+    ImagePixel gray;
+    gray.createFromSamples(std::move(samples), image.getWidth(), image.getHeight(), 1);
+    return gray;
+}
+
+// Builds the trees of one image with every builder and checks that they encode to the same bytes
+// as the pyramid build, for error methods 1-5 on the image and on a gray copy of it
+int main(int argc, char* argv[]) {
+    std::string inputPath = argc > 1 ? argv[1] : "test/input.png";
+    ImagePixel original;
+    if (!original.loadImage(inputPath)) {
+        std::cerr << "Failed to load image: " << inputPath << std::endl;
+        return 1;
+    }
+
+    const BuilderCase reference = {"pyramid", QuadTreeCompressor::PYRAMID_BUILD, false, false, false};
+    const BuilderCase builders[] = {
+        {"fused", QuadTreeCompressor::FUSED_BUILD, false, false, false},
+        {"fused/morton", QuadTreeCompressor::FUSED_BUILD, false, true, false},
+        {"fused/partitioned", QuadTreeCompressor::FUSED_BUILD, true, true, false},
+        {"bounded", QuadTreeCompressor::BOUNDED_BUILD, false, false, false},
+        {"bounded/morton", QuadTreeCompressor::BOUNDED_BUILD, false, true, false},
+        {"bounded/partitioned", QuadTreeCompressor::BOUNDED_BUILD, true, false, false},
+        {"bounded/histogram", QuadTreeCompressor::BOUNDED_BUILD, false, false, true},
+        {"bounded/histogram/morton", QuadTreeCompressor::BOUNDED_BUILD, false, true, true},
+        {"bounded/histogram/partitioned", QuadTreeCompressor::BOUNDED_BUILD, true, false, true},
+        {"level", QuadTreeCompressor::LEVEL_BUILD, false, false, false},
+    };
+    const ErrorCalculator::ErrorMethod methods[] = {
+        ErrorCalculator::VARIANCE, ErrorCalculator::MEAN_ABSOLUTE_DEVIATION, ErrorCalculator::MAX_PIXEL_DIFFERENCE,
+        ErrorCalculator::ENTROPY, ErrorCalculator::SSIM,
+    };
+    const double thresholds[] = {0.005, 0.05};
+    const int minBlockSize = 2;
+
+    ImagePixel images[2] = {original, grayCopy(original)};
+    ImagePixel tiled[2] = {images[0], images[1]};
+    for (ImagePixel& image : tiled) image.enableMortonTiles();
+
+    int checks = 0, failures = 0;
+    for (int i = 0; i < 2; i++) {
+        for (ErrorCalculator::ErrorMethod method : methods) {
+            for (double threshold : thresholds) {
+                std::vector<uint8_t> expected = encodeTree(images[i], reference, method, threshold, minBlockSize);
+                for (const BuilderCase& builder : builders) {
+                    if (builder.histogramBounds && !ErrorCalculator::requiresHistogram(method)) continue;
+                    ImagePixel& image = builder.morton ? tiled[i] : images[i];
+                    checks++;
+                    if (encodeTree(image, builder, method, threshold, minBlockSize) == expected) continue;
+                    failures++;
+                    std::cerr << builder.name << " differs from " << reference.name << ": method " << method
+                              << ", threshold " << threshold << ", " << image.getChannels() << " channel(s)\n";
+                }
+            }
+        }
+    }
+
+    std::cout << checks << " builds checked against the pyramid builder, " << failures << " differ" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "../src/header/ImagePixel.hpp"
+#include "../src/header/QuadTreeNode.hpp"
+#include "../src/header/LinearQuadTree.hpp"
+
+// Image whose every pixel differs from its neighbours, so a threshold of 0 splits down to pixels
+static ImagePixel patternImage(int width, int height) {
+    ImagePixel image;
+    image.create(width, height, 3);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            image.setPixel(x, y, Pixel{static_cast<uint8_t>(x * 37 + y * 11), static_cast<uint8_t>(x * y * 13),
+                                       static_cast<uint8_t>(y * 50 + x), 255});
+        }
+    }
+    return image;
+}
+
+// Checks leafAt against the reconstruction of the linear tree at every pixel
+static int checkLeafAt(const LinearQuadTree& tree, const std::string& name) {
+    ImagePixel reconstructed;
+    tree.reconstruct(reconstructed);
+    int failures = 0;
+    for (int y = 0; y < tree.getHeight(); y++) {
+        for (int x = 0; x < tree.getWidth(); x++) {
+            if (tree.leafAt(x, y).color == reconstructed.getPixel(x, y)) continue;
+            failures++;
+            std::cerr << name << ": leafAt(" << x << ", " << y << ") returns the wrong leaf\n";
+        }
+    }
+    return failures;
+}
+
+// Point queries of linear trees built from small odd-sized images split down to single pixels,
+// for every minimum block size up to 2, and rejection of leaves that cover no pixel
+int main() {
+    int checks = 0, failures = 0;
+    const int sizes[][2] = {{7, 5}, {5, 7}, {3, 1}, {1, 4}, {9, 9}};
+    for (const auto& size : sizes) {
+        ImagePixel image = patternImage(size[0], size[1]);
+        for (int minBlockSize = 0; minBlockSize <= 2; minBlockSize++) {
+            QuadTreeCompressor compressor(image, ErrorCalculator::VARIANCE, 0.0, minBlockSize);
+            compressor.compress();
+            LinearQuadTree tree = LinearQuadTree::fromTree(compressor.getRoot(), image.getWidth(),
+                                                           image.getHeight(), image.getChannels());
+            std::string name = std::to_string(size[0]) + "x" + std::to_string(size[1]) + ", min block " +
+                               std::to_string(minBlockSize);
+            checks++;
+            if (checkLeafAt(tree, name) > 0) failures++;
+        }
+    }
+
+    // A 1x3 image split once: its west quadrants are 0 pixels wide
+    std::vector<LinearLeaf> leaves;
+    for (uint64_t quadrant = 0; quadrant < 4; quadrant++) {
+        leaves.push_back(LinearLeaf{quadrant << (2 * (LinearQuadTree::maxLevels - 1)), 1, Pixel{0, 0, 0, 255}});
+    }
+    checks++;
+    try {
+        LinearQuadTree tree(1, 3, 3, leaves);
+        failures++;
+        std::cerr << "zero-area leaves: accepted\n";
+    } catch (const std::invalid_argument&) {
+    }
+
+    std::cout << checks << " linear quadtree checks, " << failures << " failed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}